@@ -2,13 +2,17 @@
 #define CTS_ALLOCATOR_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 /**
  * CtsAllocator is required to create objects in the C type system
  * It is basically an interface for any memory allocator, allowing flexibility for custom allocators
- * We offer 2 varieties of allocators, the 'default' allocator and a pool allocator
+ * We offer 3 varieties of allocators, the 'default' allocator, a pool allocator and an arena allocator,
+ * plus a thread safe wrapper that can be put in front of any of them
  * 'default' allocator is a simple wrap around malloc/realloc/free
  * pool allocators are created from a pool of memory. they behave exactly like malloc/realloc/free except they only allocate memory from the pool
+ * arena allocators bump a pointer through blocks taken from another allocator. free does nothing, memory is
+ * handed back all at once by releasing to a mark, which suits scratch memory that dies together
 */
 typedef struct CtsAllocator
 {
@@ -23,8 +27,46 @@ CtsAllocator* cts_allocator_get_default();
 
 // creates an allocator that allocates memory from a blob of memory
 // this is useful for localising memory allocations and preventing heap fragmentation
+// pools up to ~512KB use 16 bit block indices, bigger ones switch to 32 bit indices (see pool_allocator.h)
+// the pool isn't thread safe
 CtsAllocator* cts_allocator_from_pool(void* pool, size_t pool_size);
 
+// creates an arena that takes blocks of block_size bytes from parent, and more blocks when they fill up.
+// allocations are 8 byte aligned
+CtsAllocator* cts_allocator_arena_new(CtsAllocator* parent, size_t block_size);
+void cts_allocator_arena_delete(CtsAllocator* arena);
+
+// a position in an arena. releasing to it gives back everything allocated after the mark was taken.
+// nothing is destructed, objects that hold references outside the arena still need unreffing first
+typedef struct CtsArenaMark
+{
+    void* block;
+    size_t used;
+    size_t live;
+} CtsArenaMark;
+
+CtsArenaMark cts_allocator_arena_mark(CtsAllocator* arena);
+void cts_allocator_arena_release_to_mark(CtsAllocator* arena, CtsArenaMark mark);
+
+// makes parent safe to share between threads. small blocks are cached per thread so most allocations and
+// frees don't lock, everything else goes to parent under a mutex. a block may be freed by any thread.
+// a thread's cache goes back to parent when the thread exits, so delete only after the other threads that
+// used the allocator have exited. with CTS_NO_THREADS there is no locking and a single cache
+CtsAllocator* cts_allocator_thread_safe_new(CtsAllocator* parent);
+void cts_allocator_thread_safe_delete(CtsAllocator* allocator);
+
+// counters for the calling thread. locked_calls counts the times the thread took the lock on parent
+typedef struct CtsAllocatorStats
+{
+    size_t allocs;
+    size_t frees;
+    size_t cache_hits;
+    size_t locked_calls;
+} CtsAllocatorStats;
+
+// false if the calling thread hasn't used the allocator yet, stats is zeroed then
+bool cts_allocator_thread_safe_get_stats(CtsAllocator* allocator, CtsAllocatorStats* stats);
+
 // allocation functions
 void* cts_allocator_alloc(CtsAllocator* allocator, size_t size);
 void* cts_allocator_realloc(CtsAllocator* allocator, void* ptr, size_t size);
@@ -166,6 +166,36 @@ void cts_array_sort(CtsArray* self, ArrayCompareFunc func)
     }
 }
 
+bool cts_array_reserve(CtsArray* self, size_t n)
+{
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if (self->private == NULL) {
+        return false;
+    }
+    if (n <= self->private->reserved) {
+        return true;
+    }
+    cts_pointer* new_objs = cts_allocator_alloc(alloc, sizeof(cts_pointer) * n);
+    if (new_objs == NULL) {
+        return false;
+    }
+    if (self->private->objs != NULL) {
+        memcpy(new_objs, self->private->objs, sizeof(cts_pointer) * self->private->length);
+        cts_allocator_free(alloc, self->private->objs);
+    }
+    self->private->objs = new_objs;
+    self->private->reserved = n;
+    return true;
+}
+
+void cts_array_clear(CtsArray* self)
+{
+    if (self->private == NULL) {
+        return;
+    }
+    self->private->length = 0;
+}
+
 void cts_array_free(CtsArray* self)
 {
     if (self->private == NULL) {
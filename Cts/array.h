@@ -11,6 +11,8 @@
  * 4. Access Elements: Elements can be accessed directly via their index position.
  * 5. Array Sorting: Built-in sort function to order array elements based on a provided comparison function.
  * 6. Length Querying: Ability to quickly return the number of elements within the array.
+ * 7. Reuse: cts_array_reserve() grows the storage up front and cts_array_clear() empties the array without
+ *    releasing it, so an array can be refilled many times without touching the allocator.
  *
  * Importantly, CtsArray must be allocated with a CtsAllocator. This allocator is used to manage the memory 
  * required for the array's internal structure. Once the array is no longer needed, it should be deallocated 
@@ -60,6 +62,8 @@ cts_pointer cts_array_replace(CtsArray* self, size_t index, cts_pointer obj);
 void cts_array_reverse(CtsArray* self);
 size_t cts_array_get_length(CtsArray* self);
 void cts_array_sort(CtsArray* self, ArrayCompareFunc func);
+bool cts_array_reserve(CtsArray* self, size_t n);
+void cts_array_clear(CtsArray* self);
 void cts_array_free(CtsArray* self);
 void cts_array_free_full(CtsArray* self, CtsAllocator* alloc, ArrayFreeFunc func);
 
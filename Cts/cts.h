@@ -15,6 +15,7 @@
 #include "slist.h"
 #include "stack.h"
 #include "rbtree.h"
+#include "indexed_heap.h"
 
 
 #endif
@@ -176,12 +176,14 @@ bool cts_hash_map_set(CtsHashMap* self, cts_pointer key, cts_pointer value)
     HashMapBucketNode* node = self->priv->buckets[bucket_index];
     while (node != NULL) {
         if (priv->equal_func(node->key, key)) {
-            self->priv->key_destroy_func(
-                self->priv->key_user_pointer,
-                node->key);
-            self->priv->value_destroy_func(
-                self->priv->value_user_pointer,
-                node->value);
+            if(self->priv->key_destroy_func != NULL)
+                self->priv->key_destroy_func(
+                    self->priv->key_user_pointer,
+                    node->key);
+            if(self->priv->value_destroy_func != NULL)
+                self->priv->value_destroy_func(
+                    self->priv->value_user_pointer,
+                    node->value);
             node->key = key;
             node->value = value;
 
@@ -0,0 +1,177 @@
+#include <string.h>
+#include "indexed_heap.h"
+#include "allocator.h"
+
+CTS_DEFINE_TYPE(CtsBase, cts_base, CtsIndexedHeap, cts_indexed_heap)
+
+bool cts_indexed_heap_construct(CtsIndexedHeap* self) {
+    self->heap = NULL;
+    self->position = NULL;
+    self->priority = NULL;
+    self->size = 0;
+    self->capacity = 0;
+    return true;
+}
+
+static void cts_indexed_heap_free_arrays(CtsIndexedHeap* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if(self->heap != NULL) {
+        cts_allocator_free(alloc, self->heap);
+        self->heap = NULL;
+    }
+    if(self->position != NULL) {
+        cts_allocator_free(alloc, self->position);
+        self->position = NULL;
+    }
+    if(self->priority != NULL) {
+        cts_allocator_free(alloc, self->priority);
+        self->priority = NULL;
+    }
+}
+
+void cts_indexed_heap_destruct(CtsIndexedHeap* self) {
+    cts_indexed_heap_free_arrays(self);
+}
+
+bool cts_indexed_heap_reserve(CtsIndexedHeap* self, size_t capacity) {
+    if(capacity <= self->capacity) {
+        return true;
+    }
+
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    size_t* heap = cts_allocator_alloc(alloc, capacity * sizeof(size_t));
+    size_t* position = cts_allocator_alloc(alloc, capacity * sizeof(size_t));
+    double* priority = cts_allocator_alloc(alloc, capacity * sizeof(double));
+    if((heap == NULL) || (position == NULL) || (priority == NULL)) {
+        if(heap != NULL) cts_allocator_free(alloc, heap);
+        if(position != NULL) cts_allocator_free(alloc, position);
+        if(priority != NULL) cts_allocator_free(alloc, priority);
+        return false;
+    }
+
+    // keep whatever is queued
+    for(size_t i = 0; i < capacity; i++) {
+        position[i] = CTS_INDEXED_HEAP_NONE;
+    }
+    if(self->capacity > 0) {
+        memcpy(heap, self->heap, self->size * sizeof(size_t));
+        memcpy(position, self->position, self->capacity * sizeof(size_t));
+        memcpy(priority, self->priority, self->capacity * sizeof(double));
+    }
+    cts_indexed_heap_free_arrays(self);
+
+    self->heap = heap;
+    self->position = position;
+    self->priority = priority;
+    self->capacity = capacity;
+    return true;
+}
+
+static void cts_indexed_heap_place(CtsIndexedHeap* self, size_t i, size_t id) {
+    self->heap[i] = id;
+    self->position[id] = i;
+}
+
+static void cts_indexed_heap_sift_up(CtsIndexedHeap* self, size_t i) {
+    size_t id = self->heap[i];
+    double priority = self->priority[id];
+
+    // Move the hole up until the parent is smaller
+    while(i != 0) {
+        size_t parent = (i - 1) / 2;
+        if(!(priority < self->priority[self->heap[parent]])) {
+            break;
+        }
+        cts_indexed_heap_place(self, i, self->heap[parent]);
+        i = parent;
+    }
+    cts_indexed_heap_place(self, i, id);
+}
+
+static void cts_indexed_heap_sift_down(CtsIndexedHeap* self, size_t i) {
+    size_t id = self->heap[i];
+    double priority = self->priority[id];
+
+    // Move the hole down to the smaller child until both children are larger
+    while(true) {
+        size_t child = 2 * i + 1;
+        if(child >= self->size) {
+            break;
+        }
+        if((child + 1 < self->size) && (self->priority[self->heap[child + 1]] < self->priority[self->heap[child]])) {
+            child++;
+        }
+        if(!(self->priority[self->heap[child]] < priority)) {
+            break;
+        }
+        cts_indexed_heap_place(self, i, self->heap[child]);
+        i = child;
+    }
+    cts_indexed_heap_place(self, i, id);
+}
+
+bool cts_indexed_heap_push(CtsIndexedHeap* self, size_t id, double priority) {
+    if((id >= self->capacity) || (self->position[id] != CTS_INDEXED_HEAP_NONE)) {
+        return false;
+    }
+    self->priority[id] = priority;
+    cts_indexed_heap_place(self, self->size++, id);
+    cts_indexed_heap_sift_up(self, self->size - 1);
+    return true;
+}
+
+bool cts_indexed_heap_decrease_key(CtsIndexedHeap* self, size_t id, double priority) {
+    if((id >= self->capacity) || (self->position[id] == CTS_INDEXED_HEAP_NONE) || (priority > self->priority[id])) {
+        return false;
+    }
+    self->priority[id] = priority;
+    cts_indexed_heap_sift_up(self, self->position[id]);
+    return true;
+}
+
+size_t cts_indexed_heap_pop(CtsIndexedHeap* self) {
+    if(self->size == 0) {
+        return CTS_INDEXED_HEAP_NONE;
+    }
+
+    size_t id = self->heap[0];
+    self->position[id] = CTS_INDEXED_HEAP_NONE;
+
+    // Move the last element to the root and restore the heap property
+    self->size--;
+    if(self->size > 0) {
+        cts_indexed_heap_place(self, 0, self->heap[self->size]);
+        cts_indexed_heap_sift_down(self, 0);
+    }
+    return id;
+}
+
+size_t cts_indexed_heap_peek(CtsIndexedHeap* self) {
+    if(self->size == 0) {
+        return CTS_INDEXED_HEAP_NONE;
+    }
+    return self->heap[0];
+}
+
+double cts_indexed_heap_get_priority(CtsIndexedHeap* self, size_t id) {
+    return self->priority[id];
+}
+
+bool cts_indexed_heap_contains(CtsIndexedHeap* self, size_t id) {
+    return (id < self->capacity) && (self->position[id] != CTS_INDEXED_HEAP_NONE);
+}
+
+size_t cts_indexed_heap_get_size(CtsIndexedHeap* self) {
+    return self->size;
+}
+
+bool cts_indexed_heap_is_empty(CtsIndexedHeap* self) {
+    return self->size == 0;
+}
+
+void cts_indexed_heap_clear(CtsIndexedHeap* self) {
+    for(size_t i = 0; i < self->size; i++) {
+        self->position[self->heap[i]] = CTS_INDEXED_HEAP_NONE;
+    }
+    self->size = 0;
+}
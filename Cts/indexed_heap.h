@@ -0,0 +1,60 @@
+/*
+ * CtsIndexedHeap is a binary min heap of integer ids 0 .. capacity - 1, each with a double priority.
+ * It keeps the position of every id in the heap, so the priority of an id that is already queued can be
+ * lowered in O(log n) with `cts_indexed_heap_decrease_key` instead of searching for it. This is the
+ * open set shape Dijkstra and A* want when the vertices are numbered.
+ *
+ * The CtsIndexedHeap provides methods to:
+ *  - Make room for more ids with `cts_indexed_heap_reserve`.
+ *  - Queue an id with `cts_indexed_heap_push`.
+ *  - Lower the priority of a queued id with `cts_indexed_heap_decrease_key`.
+ *  - Remove and return the id with the lowest priority with `cts_indexed_heap_pop`.
+ *  - Look at the lowest id and its priority with `cts_indexed_heap_peek` and `cts_indexed_heap_get_priority`.
+ *  - Check whether an id is queued with `cts_indexed_heap_contains`.
+ *  - Empty the heap in O(size) with `cts_indexed_heap_clear`.
+ *
+ * Every id can be in the heap at most once. Memory is only allocated by `cts_indexed_heap_reserve`,
+ * pushing ids below the reserved capacity never allocates.
+ *
+ * Here's an example of how to use CtsIndexedHeap:
+ * \code
+ * CtsIndexedHeap* heap = cts_indexed_heap_new(alloc);
+ * cts_indexed_heap_reserve(heap, 10);
+ *
+ * cts_indexed_heap_push(heap, 3, 5.0);
+ * cts_indexed_heap_push(heap, 7, 2.0);
+ * cts_indexed_heap_decrease_key(heap, 3, 1.0);
+ *
+ * size_t id = cts_indexed_heap_pop(heap); // 3
+ *
+ * cts_indexed_heap_unref(heap);
+ * \endcode
+ */
+
+#ifndef CTS_INDEXED_HEAP_H
+#define CTS_INDEXED_HEAP_H
+
+#include "object.h"
+
+#define CTS_INDEXED_HEAP_NONE ((size_t)-1)
+
+CTS_BEGIN_DECLARE_TYPE(CtsBase, CtsIndexedHeap, cts_indexed_heap)
+size_t* heap; // ids in heap order
+size_t* position; // heap position of every id, CTS_INDEXED_HEAP_NONE if it isn't queued
+double* priority; // priority of every queued id
+size_t size;
+size_t capacity;
+CTS_END_DECLARE_TYPE(CtsIndexedHeap, cts_indexed_heap)
+
+bool cts_indexed_heap_reserve(CtsIndexedHeap* self, size_t capacity);
+bool cts_indexed_heap_push(CtsIndexedHeap* self, size_t id, double priority);
+bool cts_indexed_heap_decrease_key(CtsIndexedHeap* self, size_t id, double priority);
+size_t cts_indexed_heap_pop(CtsIndexedHeap* self);
+size_t cts_indexed_heap_peek(CtsIndexedHeap* self);
+double cts_indexed_heap_get_priority(CtsIndexedHeap* self, size_t id);
+bool cts_indexed_heap_contains(CtsIndexedHeap* self, size_t id);
+size_t cts_indexed_heap_get_size(CtsIndexedHeap* self);
+bool cts_indexed_heap_is_empty(CtsIndexedHeap* self);
+void cts_indexed_heap_clear(CtsIndexedHeap* self);
+
+#endif
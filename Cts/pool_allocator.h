@@ -0,0 +1,16 @@
+#ifndef CTS_POOL_ALLOCATOR_H
+#define CTS_POOL_ALLOCATOR_H
+
+#include "allocator.h"
+
+/*
+ * pool allocators for each block index width, cts_allocator_from_pool picks between them.
+ * both return NULL if the pool is too small, or holds more chunks than the index width can address.
+ *
+ * 16 bit: 8 byte chunks, 4 byte header per allocation, pools up to ~512KB
+ * 32 bit: 16 byte chunks, 8 byte header per allocation, pools up to ~64GB
+ */
+CtsAllocator* cts_pool16_new(void* pool, size_t pool_size);
+CtsAllocator* cts_pool32_new(void* pool, size_t pool_size);
+
+#endif
@@ -0,0 +1,4 @@
+#define POOL_INDEX uint16_t
+#define POOL_INDEX_MAX UINT16_MAX
+#define POOL_NEW cts_pool16_new
+#include "pool_allocator_impl.h"
@@ -0,0 +1,4 @@
+#define POOL_INDEX uint32_t
+#define POOL_INDEX_MAX UINT32_MAX
+#define POOL_NEW cts_pool32_new
+#include "pool_allocator_impl.h"
@@ -0,0 +1,413 @@
+/*
+ * the pool allocator behind cts_allocator_from_pool, compiled once per block index width by
+ * pool_allocator16.c and pool_allocator32.c. before including this file define
+ *
+ *   POOL_INDEX      unsigned type of block sizes and free list links
+ *   POOL_INDEX_MAX  its largest value, used as the 'no block' link
+ *   POOL_NEW        name of the constructor, see pool_allocator.h
+ *
+ * memory is handed out in chunks of 4 POOL_INDEX, a pool can hold up to POOL_INDEX_MAX of them.
+ */
+#include "pool_allocator.h"
+#include <stdint.h>
+#include <string.h>
+
+typedef struct AllocatedHead 
+{
+    POOL_INDEX size;
+    POOL_INDEX used; // BLOCK_ flags
+} AllocatedHead;
+
+typedef struct BlockHead
+{
+    POOL_INDEX size;
+    POOL_INDEX used;
+    POOL_INDEX next;
+    POOL_INDEX prev;
+} BlockHead;
+
+#define CHUNK_SIZE sizeof(BlockHead)
+
+typedef union Block
+{
+    BlockHead head;        // when block is free
+    char data[CHUNK_SIZE]; // when block is occupied
+} Block;
+
+/*
+ * boundary tags: a free block also stores its size in the last POOL_INDEX of its last chunk, and the block
+ * after it has BLOCK_PREV_FREE set. that is enough to find both physical neighbours of a block in O(1),
+ * so a freed block is merged with them straight away and two free blocks are never adjacent.
+ * blocks are at least 2 chunks so the footer never overlaps the free list links.
+ */
+#define BLOCK_USED 1
+#define BLOCK_PREV_FREE 2
+#define MIN_BLOCK_CHUNKS 2
+
+/*
+ * free blocks are kept in segregated lists by size class, two level segregated fit (TLSF) style.
+ * the first level splits sizes by powers of two, the second level splits each power of two into
+ * POOL_SL_COUNT linear classes. a bitmap per level records which lists are non empty, so finding a
+ * list that is guaranteed to fit a request is a couple of bit scans instead of a walk of the free blocks.
+ * sizes are counted in chunks.
+ */
+#define POOL_SL_BITS 3
+#define POOL_SL_COUNT (1 << POOL_SL_BITS)
+#define POOL_FL_COUNT (sizeof(POOL_INDEX) * 8 - POOL_SL_BITS + 1)
+#define POOL_NO_BLOCK POOL_INDEX_MAX
+
+typedef struct Pool
+{
+    CtsAllocator allocator;
+    Block *blocks;
+    size_t num_blocks;
+    uint32_t fl_bitmap;
+    uint8_t sl_bitmap[POOL_FL_COUNT];
+    POOL_INDEX free_lists[POOL_FL_COUNT][POOL_SL_COUNT];
+} Pool;
+
+static size_t chunks_for(size_t size);
+static void size_class(size_t size, unsigned *fl, unsigned *sl);
+static POOL_INDEX find_free_block(Pool *pool, size_t n_chunks);
+static void insert_free_block(Pool *pool, POOL_INDEX i);
+static void remove_free_block(Pool *pool, POOL_INDEX i);
+static int block_is_free(Block *block);
+static POOL_INDEX *block_footer(Pool *pool, size_t i);
+static size_t prev_block_size(Block *block);
+static void release_block(Pool *pool, size_t i);
+static void join_next(Pool *pool, size_t i);
+static void split_block(Pool *pool, Block *n, uint32_t split_pos);
+static void* pool_alloc(CtsAllocator *pool, size_t size);
+static void* pool_realloc(CtsAllocator *pool, void *ptr, size_t size);
+static void pool_free(CtsAllocator *pool, void *ptr);
+
+
+static int block_is_free(Block *block)
+{
+    return ((block->head.used & BLOCK_USED) == 0);
+}
+
+static POOL_INDEX *block_footer(Pool *pool, size_t i)
+{
+    Block *last = &pool->blocks[i + pool->blocks[i].head.size - 1];
+    return (POOL_INDEX *)&last->data[CHUNK_SIZE - sizeof(POOL_INDEX)];
+}
+
+// size of the free block before this one, read from its footer. only valid with BLOCK_PREV_FREE set
+static size_t prev_block_size(Block *block)
+{
+    return *(POOL_INDEX *)&block[-1].data[CHUNK_SIZE - sizeof(POOL_INDEX)];
+}
+
+// number of chunks a block needs to hold size bytes
+static size_t chunks_for(size_t size)
+{
+    size_t N = size + sizeof(AllocatedHead);
+    size_t n_chunks = N / CHUNK_SIZE + ((N % CHUNK_SIZE != 0) * 1);
+    return (n_chunks < MIN_BLOCK_CHUNKS) ? MIN_BLOCK_CHUNKS : n_chunks;
+}
+
+static void size_class(size_t size, unsigned *fl, unsigned *sl)
+{
+    if (size < POOL_SL_COUNT)
+    {
+        *fl = 0;
+        *sl = size;
+        return;
+    }
+    unsigned msb = 31 - __builtin_clz((uint32_t)size);
+    *fl = msb - POOL_SL_BITS + 1;
+    *sl = (size >> (msb - POOL_SL_BITS)) - POOL_SL_COUNT;
+}
+
+// head of the first non empty list whose blocks are all at least n_chunks long
+static POOL_INDEX find_free_block(Pool *pool, size_t n_chunks)
+{
+    if (n_chunks > POOL_INDEX_MAX)
+    {
+        return POOL_NO_BLOCK;
+    }
+    unsigned fl, sl;
+    size_class(n_chunks, &fl, &sl);
+
+    // round up to the next class boundary so any block of the class fits
+    size_t rounded = n_chunks;
+    if (n_chunks >= POOL_SL_COUNT)
+    {
+        unsigned msb = 31 - __builtin_clz((uint32_t)n_chunks);
+        rounded += (1u << (msb - POOL_SL_BITS)) - 1;
+    }
+    if (rounded <= POOL_INDEX_MAX)
+    {
+        unsigned rfl, rsl;
+        size_class(rounded, &rfl, &rsl);
+
+        uint32_t sl_map = pool->sl_bitmap[rfl] & (~0u << rsl);
+        if (sl_map == 0)
+        {
+            uint32_t fl_map = pool->fl_bitmap & (~0u << (rfl + 1));
+            if (fl_map != 0)
+            {
+                rfl = __builtin_ctz(fl_map);
+                sl_map = pool->sl_bitmap[rfl];
+            }
+        }
+        if (sl_map != 0)
+        {
+            return pool->free_lists[rfl][__builtin_ctz(sl_map)];
+        }
+    }
+
+    // nothing in the bigger classes, the request's own class may still hold a block that fits
+    POOL_INDEX head = pool->free_lists[fl][sl];
+    if ((head != POOL_NO_BLOCK) && (pool->blocks[head].head.size >= n_chunks))
+    {
+        return head;
+    }
+    return POOL_NO_BLOCK;
+}
+
+static void insert_free_block(Pool *pool, POOL_INDEX i)
+{
+    Block *block = &pool->blocks[i];
+    unsigned fl, sl;
+    size_class(block->head.size, &fl, &sl);
+
+    POOL_INDEX head = pool->free_lists[fl][sl];
+    if (head != POOL_NO_BLOCK)
+    {
+        pool->blocks[head].head.prev = i;
+    }
+    block->head.next = head;
+    block->head.prev = POOL_NO_BLOCK;
+    block->head.used = 0; // the block before a free block is never free
+    *block_footer(pool, i) = block->head.size;
+    if (i + block->head.size < pool->num_blocks)
+    {
+        pool->blocks[i + block->head.size].head.used |= BLOCK_PREV_FREE;
+    }
+
+    pool->free_lists[fl][sl] = i;
+    pool->fl_bitmap |= 1u << fl;
+    pool->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void remove_free_block(Pool *pool, POOL_INDEX i)
+{
+    Block *block = &pool->blocks[i];
+    unsigned fl, sl;
+    size_class(block->head.size, &fl, &sl);
+
+    POOL_INDEX next_index = block->head.next;
+    POOL_INDEX prev_index = block->head.prev;
+    if (next_index != POOL_NO_BLOCK)
+    {
+        pool->blocks[next_index].head.prev = prev_index;
+    }
+    if (prev_index != POOL_NO_BLOCK)
+    {
+        pool->blocks[prev_index].head.next = next_index;
+    }
+    else
+    {
+        // the block was the head of its list
+        pool->free_lists[fl][sl] = next_index;
+        if (next_index == POOL_NO_BLOCK)
+        {
+            pool->sl_bitmap[fl] &= ~(1u << sl);
+            if (pool->sl_bitmap[fl] == 0)
+            {
+                pool->fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+    block->head.used = BLOCK_USED;
+    if (i + block->head.size < pool->num_blocks)
+    {
+        pool->blocks[i + block->head.size].head.used &= ~BLOCK_PREV_FREE;
+    }
+}
+
+// frees block i, merging it with whichever physical neighbours are free
+static void release_block(Pool *pool, size_t i)
+{
+    size_t size = pool->blocks[i].head.size;
+
+    size_t next = i + size;
+    if ((next < pool->num_blocks) && block_is_free(&pool->blocks[next]))
+    {
+        remove_free_block(pool, next);
+        size += pool->blocks[next].head.size;
+    }
+
+    if (pool->blocks[i].head.used & BLOCK_PREV_FREE)
+    {
+        size_t prev_size = prev_block_size(&pool->blocks[i]);
+        i -= prev_size;
+        remove_free_block(pool, i);
+        size += prev_size;
+    }
+
+    pool->blocks[i].head.size = size;
+    insert_free_block(pool, i);
+}
+
+// cuts n down to split_pos chunks and frees the rest, if the rest is big enough to be a block
+static void split_block(Pool *pool, Block *n, uint32_t split_pos)
+{
+    if (n->head.size < split_pos + MIN_BLOCK_CHUNKS)
+    {
+        return;
+    }
+    POOL_INDEX split_index = (n - pool->blocks) + split_pos;
+    Block *sp = &pool->blocks[split_index];
+
+    sp->head.size = n->head.size - split_pos;
+    sp->head.used = BLOCK_USED;
+    n->head.size = split_pos;
+    release_block(pool, split_index);
+}
+
+// merges the free block that directly follows block_n into it
+static void join_next(Pool *pool, size_t block_n)
+{
+    size_t next = block_n + pool->blocks[block_n].head.size;
+    if ((next < pool->num_blocks) && block_is_free(&pool->blocks[next]))
+    {
+        remove_free_block(pool, next);
+        pool->blocks[block_n].head.size += pool->blocks[next].head.size;
+    }
+}
+
+static void *pool_alloc(CtsAllocator *self, size_t size)
+{
+    Pool *pool = (Pool *)self;
+    size_t n_chunks = chunks_for(size);
+
+    POOL_INDEX i = find_free_block(pool, n_chunks);
+    if (i == POOL_NO_BLOCK)
+    {
+        return NULL;
+    }
+
+    Block *block = &pool->blocks[i];
+    remove_free_block(pool, i);
+    // give the tail back to the free lists
+    split_block(pool, block, n_chunks);
+    return (void *)&block->data[sizeof(AllocatedHead)];
+}
+
+static void *pool_realloc(CtsAllocator *self, void *ptr, size_t size)
+{
+    Pool *pool = (Pool *)self;
+    if (ptr == NULL)
+    {
+        return pool_alloc(self, size);
+    }
+
+    uint8_t *bptr = (uint8_t *)ptr;
+    bptr -= sizeof(AllocatedHead);
+    Block *block = (Block *)bptr;
+    size_t old_chunks = block->head.size;
+    size_t n_chunks = chunks_for(size);
+
+    // the allocation needs to be shrunk down
+    if (old_chunks > n_chunks)
+    {
+        split_block(pool, block, n_chunks);
+        return ptr;
+    }
+    // the allocation needs to grow larger
+    else if (old_chunks < n_chunks)
+    {
+        // first attempt to join on the free block after it
+        join_next(pool, block - pool->blocks);
+
+        if (block->head.size >= n_chunks)
+        {
+            split_block(pool, block, n_chunks);
+            return ptr; // return original pointer because nothing moved
+        }
+
+        // then the free block before it, sliding the contents down
+        if (block->head.used & BLOCK_PREV_FREE)
+        {
+            size_t prev_size = prev_block_size(block);
+            if (prev_size + block->head.size >= n_chunks)
+            {
+                Block *prev = block - prev_size;
+                remove_free_block(pool, prev - pool->blocks);
+                prev->head.size += block->head.size;
+                memmove(&prev->data[sizeof(AllocatedHead)], ptr, old_chunks * CHUNK_SIZE - sizeof(AllocatedHead));
+                split_block(pool, prev, n_chunks);
+                return (void *)&prev->data[sizeof(AllocatedHead)];
+            }
+        }
+
+        // worst case scenario, move it
+        void *n = pool_alloc(self, size);
+        if (n == NULL)
+        {
+            return NULL;
+        }
+        memcpy(n, ptr, old_chunks * CHUNK_SIZE - sizeof(AllocatedHead));
+        pool_free(self, ptr);
+        return n;
+    }
+    // the allocation is fine
+    else
+    {
+        return ptr;
+    }
+}
+
+static void pool_free(CtsAllocator *self, void *ptr)
+{
+    Pool *pool = (Pool *)self;
+    if (ptr != NULL)
+    {
+        uint8_t *bptr = (uint8_t *)ptr;
+        bptr -= sizeof(AllocatedHead);
+        Block *block = (Block *)bptr;
+        release_block(pool, block - pool->blocks);
+    }
+}
+
+CtsAllocator *POOL_NEW(void *pool_mem, size_t pool_size)
+{
+    // check if there's enough room for at least a Pool and a Block
+    if (pool_size < sizeof(Pool) + MIN_BLOCK_CHUNKS * sizeof(Block))
+    {
+        return NULL; // pool is too small
+    }
+
+    // calculate the number of blocks that fit in the remaining space
+    size_t num_blocks = (pool_size - sizeof(Pool)) / sizeof(Block);
+    if (num_blocks > POOL_INDEX_MAX)
+    {
+        return NULL; // too many blocks for the index width
+    }
+
+    // Create the Pool at the start of the provided memory region, the blocks don't need clearing
+    Pool *pool = (Pool *)pool_mem;
+    memset(pool, 0, sizeof(Pool));
+
+    // The first Block starts immediately after the Pool
+    uint8_t* ptr_bpool = (uint8_t *)pool_mem;
+    ptr_bpool += sizeof(Pool);
+    Block *block = (Block *)(ptr_bpool);
+
+    pool->allocator.alloc = pool_alloc;
+    pool->allocator.realloc = pool_realloc;
+    pool->allocator.free = pool_free;
+    pool->num_blocks = num_blocks;
+    pool->blocks = block;
+    memset(pool->free_lists, 0xff, sizeof(pool->free_lists));
+
+    // the whole pool starts out as one free block
+    block->head.size = num_blocks;
+    block->head.used = 0;
+    insert_free_block(pool, 0);
+
+    return &pool->allocator;
+}
@@ -1,5 +1,5 @@
 #include "rbtree.h"
-#include "stack.h"
+#include "block_pool.h"
 
 typedef enum { RED, BLACK } node_color;
 
@@ -14,6 +14,7 @@ typedef struct CtsRbTreePrivate {
     RbNode* root;
     size_t size;
     RbTreeCompareFunc compare_func;
+    CtsBlockPool* node_pool; // removed nodes are kept for the next inserts
 } CtsRbTreePrivate;
 
 CTS_DEFINE_TYPE(CtsBase, cts_base, CtsRbTree, cts_rb_tree)
@@ -26,12 +27,18 @@ bool cts_rb_tree_construct(CtsRbTree *self) {
     }
     self->priv->root = NULL;
     self->priv->size = 0;
+    self->priv->node_pool = cts_block_pool_new(alloc, sizeof(RbNode), 16);
+    if(self->priv->node_pool == NULL) {
+        cts_allocator_free(alloc, self->priv);
+        return false;
+    }
     return true;
 }
 
 void cts_rb_tree_destruct(CtsRbTree *self) {
     CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
     cts_rb_tree_clear(self);
+    cts_block_pool_delete(self->priv->node_pool);
     cts_allocator_free(alloc, self->priv);
 }
 
@@ -193,7 +200,7 @@ static void deleteFixUp(CtsRbTree *tree, RbNode *x, RbNode *xParent) {
 
 bool cts_rb_tree_insert(CtsRbTree* tree, cts_pointer key, cts_pointer value) {
     // Create new node
-    RbNode *newNode = cts_allocator_alloc(cts_base_get_allocator((CtsBase*)tree), sizeof(RbNode));
+    RbNode *newNode = cts_block_pool_alloc(tree->priv->node_pool);
     if (newNode == NULL) {
         return false;  // Allocation failed
     }
@@ -274,7 +281,10 @@ cts_pointer cts_rb_tree_remove(CtsRbTree* tree, cts_pointer key) {
         if (node_to_remove == tree->priv->root) {
             // Special case: root
             tree->priv->root = x;
-            if (x) x->color = BLACK;
+            if (x) {
+                x->parent = NULL;
+                x->color = BLACK;
+            }
         } else {
             if (node_to_remove == node_to_remove->parent->left) {
                 node_to_remove->parent->left = x;
@@ -320,7 +330,7 @@ cts_pointer cts_rb_tree_remove(CtsRbTree* tree, cts_pointer key) {
         }
     }
     // Finally, delete the node_to_remove and reduce the size of the tree.
-    cts_allocator_free(cts_base_get_allocator((CtsBase*)tree), node_to_remove);
+    cts_block_pool_free(tree->priv->node_pool, node_to_remove);
     tree->priv->size--;
     return old_key;
 }
@@ -360,32 +370,27 @@ void cts_rb_tree_clear_full(CtsRbTree* tree, CtsFreeFunc key_free_func, cts_poin
     if(tree->priv->root == NULL)
         return;
 
-    // Create a new stack to keep track of nodes to be visited
-    CtsStack* stack = cts_stack_new(cts_base_get_allocator((CtsBase*)tree));
-
-    // Start with the root
-    cts_stack_push(stack, tree->priv->root);
-
-    while(!cts_stack_is_empty(stack)) {
-        RbNode* current_node = (RbNode*)cts_stack_pop(stack);
-        if(current_node->left != NULL) {
-            cts_stack_push(stack, current_node->left);
-        }
-        if(current_node->right != NULL) {
-            cts_stack_push(stack, current_node->right);
+    // rotating every left child up turns the tree into a list down the right children, which is freed
+    // as it goes without a stack
+    RbNode* current_node = tree->priv->root;
+    while(current_node != NULL) {
+        RbNode* left = current_node->left;
+        if(left != NULL) {
+            current_node->left = left->right;
+            left->right = current_node;
+            current_node = left;
+            continue;
         }
+        RbNode* right = current_node->right;
         if(key_free_func != NULL) {
             key_free_func(key_ptr, current_node->key);
         }
         if(value_free_func != NULL) {
             value_free_func(val_ptr, current_node->value);
         }
-        // Deallocate the current node
-        cts_allocator_free(cts_base_get_allocator((CtsBase*)tree), current_node);
+        cts_block_pool_free(tree->priv->node_pool, current_node);
+        current_node = right;
     }
-    
-    // Deallocate the stack
-    cts_stack_unref(stack);
 
     // Set the root to NULL and reset the size
     tree->priv->root = NULL;
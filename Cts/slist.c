@@ -283,6 +283,42 @@ void cts_slist_reverse(CtsSList *self)
     self->private->head = old_end;
 }
 
+void cts_slist_truncate(CtsSList *self, size_t length)
+{
+    if (self->private == NULL || self->private->length <= length)
+    {
+        return;
+    }
+
+    CtsSListNode *node;
+    if (length == 0)
+    {
+        node = self->private->head;
+        self->private->head = NULL;
+        self->private->end = NULL;
+    }
+    else
+    {
+        CtsSListNode *last = self->private->head;
+        for (size_t i = 0; i < length - 1; ++i)
+        {
+            last = last->next;
+        }
+        node = last->next;
+        last->next = NULL;
+        self->private->end = last;
+    }
+
+    CtsAllocator *alloc = cts_base_get_allocator((CtsBase *)self);
+    while (node != NULL)
+    {
+        CtsSListNode *next = node->next;
+        cts_allocator_free(alloc, node);
+        node = next;
+    }
+    self->private->length = length;
+}
+
 void cts_slist_free(CtsSList *self)
 {
     CtsAllocator *list_alloc = cts_base_get_allocator((CtsBase *)self);
@@ -319,6 +355,21 @@ void cts_slist_free_full(CtsSList *self, cts_pointer alloc, SListFreeFunc func)
     }
 }
 
+CtsSListNode *cts_slist_first_node(CtsSList *self)
+{
+    return (self->private != NULL) ? self->private->head : NULL;
+}
+
+CtsSListNode *cts_slist_node_next(CtsSListNode *node)
+{
+    return node->next;
+}
+
+cts_pointer cts_slist_node_get(CtsSListNode *node)
+{
+    return node->obj;
+}
+
 CTS_DEFINE_TYPE(CtsBase, cts_base, CtsSListIterator, cts_slist_iterator)
 
 bool cts_slist_iterator_construct(CtsSListIterator *self)
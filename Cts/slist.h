@@ -62,9 +62,16 @@ cts_pointer cts_slist_remove_iter(CtsSList* self, CtsSListIterator* iter);
 size_t cts_slist_get_length(CtsSList* self);
 void cts_slist_sort(CtsSList* self, SListCompareFunc func);
 void cts_slist_reverse(CtsSList* self);
+void cts_slist_truncate(CtsSList* self, size_t length);
 void cts_slist_free(CtsSList* self);
 void cts_slist_free_full(CtsSList* self, cts_pointer alloc, SListFreeFunc func);
 
+// walks the list without creating an iterator, for loops that can't allocate.
+// a node stays valid until it's removed from the list, and the list isn't kept alive
+struct CtsSListNode* cts_slist_first_node(CtsSList* self);
+struct CtsSListNode* cts_slist_node_next(struct CtsSListNode* node);
+cts_pointer cts_slist_node_get(struct CtsSListNode* node);
+
 /**
  * @brief Create a new SListIterator for the given SList.
  *
@@ -0,0 +1,362 @@
+#include "allocator.h"
+#include <string.h>
+
+#ifndef CTS_NO_THREADS
+#include <pthread.h>
+#endif
+
+/*
+ * blocks of up to CACHE_MAX_SIZE bytes are rounded up to a size class, and freed ones are kept in a
+ * cache owned by the thread that freed them. the thread pops them back off without locking. a miss
+ * takes CACHE_REFILL blocks from the parent under one lock, a class holding more than CACHE_LIMIT
+ * blocks gives half of them back under one lock. bigger blocks go straight to the parent.
+ *
+ * the blocks in the caches all come from the same parent, so a block can be freed by another thread
+ * than the one that allocated it and end up in that thread's cache.
+ */
+#define CACHE_GRANULE 16
+#define CACHE_CLASSES 16
+#define CACHE_MAX_SIZE (CACHE_GRANULE * CACHE_CLASSES)
+#define CACHE_REFILL 16
+#define CACHE_LIMIT 64
+
+typedef union CachedBlock
+{
+    size_t size;              // while allocated, the class size for cached sizes
+    union CachedBlock *next;  // while in a cache
+    double align;
+} CachedBlock;
+
+typedef struct ThreadCache
+{
+    CachedBlock *bins[CACHE_CLASSES];
+    size_t counts[CACHE_CLASSES];
+    CtsAllocatorStats stats;
+    struct ThreadSafeAllocator *owner;
+} ThreadCache;
+
+typedef struct ThreadSafeAllocator
+{
+    CtsAllocator allocator;
+    CtsAllocator *parent;
+#ifndef CTS_NO_THREADS
+    pthread_mutex_t lock;
+    pthread_key_t key;
+#else
+    ThreadCache *cache;
+#endif
+} ThreadSafeAllocator;
+
+// the wrapper's own traffic with the parent goes through the vtable, so n_allocs only counts what
+// its users allocate and not the blocks waiting in caches
+
+static void ts_lock(ThreadSafeAllocator *ts)
+{
+#ifndef CTS_NO_THREADS
+    pthread_mutex_lock(&ts->lock);
+#else
+    (void)ts;
+#endif
+}
+
+static void ts_unlock(ThreadSafeAllocator *ts)
+{
+#ifndef CTS_NO_THREADS
+    pthread_mutex_unlock(&ts->lock);
+#else
+    (void)ts;
+#endif
+}
+
+// gives every block in a bin beyond keep back to the parent
+static void flush_bin(ThreadSafeAllocator *ts, ThreadCache *cache, size_t c, size_t keep)
+{
+    if (cache->counts[c] <= keep)
+    {
+        return;
+    }
+    ts_lock(ts);
+    while (cache->counts[c] > keep)
+    {
+        CachedBlock *block = cache->bins[c];
+        cache->bins[c] = block->next;
+        cache->counts[c]--;
+        ts->parent->free(ts->parent, block);
+    }
+    ts_unlock(ts);
+    cache->stats.locked_calls++;
+}
+
+static void release_cache(ThreadSafeAllocator *ts, ThreadCache *cache)
+{
+    for (size_t c = 0; c < CACHE_CLASSES; c++)
+    {
+        flush_bin(ts, cache, c, 0);
+    }
+    ts_lock(ts);
+    ts->parent->free(ts->parent, cache);
+    ts_unlock(ts);
+}
+
+#ifndef CTS_NO_THREADS
+// runs when a thread exits, its cached blocks go back to the parent
+static void thread_exit(void *data)
+{
+    ThreadCache *cache = (ThreadCache *)data;
+    release_cache(cache->owner, cache);
+}
+#endif
+
+// the calling thread's cache, created on first use. NULL if there's no memory for it, the thread then
+// goes to the parent for everything
+static ThreadCache *thread_cache(ThreadSafeAllocator *ts)
+{
+#ifndef CTS_NO_THREADS
+    ThreadCache *cache = (ThreadCache *)pthread_getspecific(ts->key);
+#else
+    ThreadCache *cache = ts->cache;
+#endif
+    if (cache != NULL)
+    {
+        return cache;
+    }
+
+    ts_lock(ts);
+    cache = (ThreadCache *)ts->parent->alloc(ts->parent, sizeof(ThreadCache));
+    ts_unlock(ts);
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(ThreadCache));
+    cache->owner = ts;
+#ifndef CTS_NO_THREADS
+    if (pthread_setspecific(ts->key, cache) != 0)
+    {
+        release_cache(ts, cache);
+        return NULL;
+    }
+#else
+    ts->cache = cache;
+#endif
+    return cache;
+}
+
+static size_t size_class(size_t size)
+{
+    return (size == 0) ? 0 : (size - 1) / CACHE_GRANULE;
+}
+
+static void *ts_alloc(CtsAllocator *self, size_t size)
+{
+    ThreadSafeAllocator *ts = (ThreadSafeAllocator *)self;
+    ThreadCache *cache = thread_cache(ts);
+    CachedBlock *block;
+
+    if ((size <= CACHE_MAX_SIZE) && (cache != NULL))
+    {
+        size_t c = size_class(size);
+        size_t class_size = (c + 1) * CACHE_GRANULE;
+        if (cache->bins[c] == NULL)
+        {
+            ts_lock(ts);
+            for (size_t i = 0; i < CACHE_REFILL; i++)
+            {
+                block = (CachedBlock *)ts->parent->alloc(ts->parent, sizeof(CachedBlock) + class_size);
+                if (block == NULL)
+                {
+                    break;
+                }
+                block->next = cache->bins[c];
+                cache->bins[c] = block;
+                cache->counts[c]++;
+            }
+            ts_unlock(ts);
+            cache->stats.locked_calls++;
+            if (cache->bins[c] == NULL)
+            {
+                return NULL;
+            }
+        }
+        else
+        {
+            cache->stats.cache_hits++;
+        }
+        block = cache->bins[c];
+        cache->bins[c] = block->next;
+        cache->counts[c]--;
+        block->size = class_size;
+    }
+    else
+    {
+        // a small block still gets its full class size, a thread with a cache may free it into one
+        if (size <= CACHE_MAX_SIZE)
+        {
+            size = (size_class(size) + 1) * CACHE_GRANULE;
+        }
+        ts_lock(ts);
+        block = (CachedBlock *)ts->parent->alloc(ts->parent, sizeof(CachedBlock) + size);
+        ts_unlock(ts);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        if (cache != NULL)
+        {
+            cache->stats.locked_calls++;
+        }
+        block->size = size;
+    }
+
+    if (cache != NULL)
+    {
+        cache->stats.allocs++;
+    }
+    return block + 1;
+}
+
+static void ts_free(CtsAllocator *self, void *ptr)
+{
+    ThreadSafeAllocator *ts = (ThreadSafeAllocator *)self;
+    if (ptr == NULL)
+    {
+        return;
+    }
+    CachedBlock *block = (CachedBlock *)ptr - 1;
+    ThreadCache *cache = thread_cache(ts);
+
+    if ((block->size <= CACHE_MAX_SIZE) && (cache != NULL))
+    {
+        size_t c = size_class(block->size);
+        block->next = cache->bins[c];
+        cache->bins[c] = block;
+        cache->counts[c]++;
+        if (cache->counts[c] > CACHE_LIMIT)
+        {
+            flush_bin(ts, cache, c, CACHE_LIMIT / 2);
+        }
+    }
+    else
+    {
+        ts_lock(ts);
+        ts->parent->free(ts->parent, block);
+        ts_unlock(ts);
+        if (cache != NULL)
+        {
+            cache->stats.locked_calls++;
+        }
+    }
+
+    if (cache != NULL)
+    {
+        cache->stats.frees++;
+    }
+}
+
+static void *ts_realloc(CtsAllocator *self, void *ptr, size_t size)
+{
+    ThreadSafeAllocator *ts = (ThreadSafeAllocator *)self;
+    if (ptr == NULL)
+    {
+        return ts_alloc(self, size);
+    }
+    CachedBlock *block = (CachedBlock *)ptr - 1;
+    size_t old_size = block->size;
+
+    // still fits the class block it has
+    if ((old_size <= CACHE_MAX_SIZE) && (size <= old_size))
+    {
+        return ptr;
+    }
+
+    // neither size is cached, the parent can resize it in place
+    if ((old_size > CACHE_MAX_SIZE) && (size > CACHE_MAX_SIZE))
+    {
+        ts_lock(ts);
+        CachedBlock *moved = (CachedBlock *)ts->parent->realloc(ts->parent, block, sizeof(CachedBlock) + size);
+        ts_unlock(ts);
+        ThreadCache *cache = thread_cache(ts);
+        if (cache != NULL)
+        {
+            cache->stats.locked_calls++;
+        }
+        if (moved == NULL)
+        {
+            return NULL;
+        }
+        moved->size = size;
+        return moved + 1;
+    }
+
+    void *moved = ts_alloc(self, size);
+    if (moved == NULL)
+    {
+        return NULL;
+    }
+    memcpy(moved, ptr, (old_size < size) ? old_size : size);
+    ts_free(self, ptr);
+    return moved;
+}
+
+CtsAllocator *cts_allocator_thread_safe_new(CtsAllocator *parent)
+{
+    ThreadSafeAllocator *ts = (ThreadSafeAllocator *)parent->alloc(parent, sizeof(ThreadSafeAllocator));
+    if (ts == NULL)
+    {
+        return NULL;
+    }
+    ts->allocator.alloc = ts_alloc;
+    ts->allocator.realloc = ts_realloc;
+    ts->allocator.free = ts_free;
+    ts->parent = parent;
+#ifndef CTS_NO_THREADS
+    if (pthread_key_create(&ts->key, thread_exit) != 0)
+    {
+        parent->free(parent, ts);
+        return NULL;
+    }
+    pthread_mutex_init(&ts->lock, NULL);
+#else
+    ts->cache = NULL;
+#endif
+    return &ts->allocator;
+}
+
+void cts_allocator_thread_safe_delete(CtsAllocator *self)
+{
+    ThreadSafeAllocator *ts = (ThreadSafeAllocator *)self;
+    CtsAllocator *parent = ts->parent;
+#ifndef CTS_NO_THREADS
+    ThreadCache *cache = (ThreadCache *)pthread_getspecific(ts->key);
+    if (cache != NULL)
+    {
+        pthread_setspecific(ts->key, NULL);
+        release_cache(ts, cache);
+    }
+    pthread_key_delete(ts->key);
+    pthread_mutex_destroy(&ts->lock);
+#else
+    if (ts->cache != NULL)
+    {
+        release_cache(ts, ts->cache);
+    }
+#endif
+    parent->free(parent, ts);
+}
+
+bool cts_allocator_thread_safe_get_stats(CtsAllocator *self, CtsAllocatorStats *stats)
+{
+    ThreadSafeAllocator *ts = (ThreadSafeAllocator *)self;
+#ifndef CTS_NO_THREADS
+    ThreadCache *cache = (ThreadCache *)pthread_getspecific(ts->key);
+#else
+    ThreadCache *cache = ts->cache;
+#endif
+    if (cache == NULL)
+    {
+        memset(stats, 0, sizeof(CtsAllocatorStats));
+        return false;
+    }
+    *stats = cache->stats;
+    return true;
+}
@@ -0,0 +1,977 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#ifndef VISIBILITY_NO_THREADS
+#include <pthread.h>
+#endif
+#include <Cts/cts.h>
+#include "polygon.h"
+#include "visibility_graph.h"
+#include "visibility_parallel.h"
+#include "segment_batch.h"
+#include "path_query.h"
+#include "path_table.h"
+
+/*
+ * Benchmarks for the path finding library. Not part of the default build, run with
+ *
+ *   make bench && ./bench [cells]
+ *
+ * Scenes are a cells x cells grid of random convex obstacles, the same seed gives the same scene.
+ */
+
+static unsigned int bench_seed = 7;
+
+static int bench_rand(int n) {
+    bench_seed = bench_seed * 1103515245u + 12345u;
+    return (bench_seed >> 8) % n;
+}
+
+static double bench_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// compact polygons keep their points in one block, see polygon_new_compact
+static Graph* bench_scene_with(CtsAllocator* alloc, int cells, bool compact) {
+    bench_seed = 7;
+    Graph* graph = graph_new(alloc);
+    for(int cx = 0; cx < cells; cx++) {
+        for(int cy = 0; cy < cells; cy++) {
+            Polygon* polygon = compact ? polygon_new_compact(alloc) : polygon_new(alloc);
+            int n = 4 + bench_rand(5);
+            for(int k = 0; k < n; k++) {
+                double a = 2 * M_PI * k / n;
+                double r = 18 * (0.4 + 0.6 * bench_rand(1000) / 1000.0);
+                polygon_add_point(polygon, cx * 40 + 20 + r * cos(a), cy * 40 + 20 + r * sin(a));
+            }
+            graph_add_polygon(graph, polygon);
+            polygon_unref(polygon);
+        }
+    }
+    graph_set_start_point(graph, point_new_with_coords(alloc, 0.5, 0.5));
+    graph_set_end_point(graph, point_new_with_coords(alloc, cells * 40 - 0.5, cells * 40 - 0.5));
+    return graph;
+}
+
+static Graph* bench_scene(CtsAllocator* alloc, int cells) {
+    return bench_scene_with(alloc, cells, false);
+}
+
+static void bench_add_box(CtsAllocator* alloc, Graph* graph, double x0, double y0, double x1, double y1) {
+    Polygon* polygon = polygon_new(alloc);
+    polygon_add_point(polygon, x0, y0);
+    polygon_add_point(polygon, x1, y0);
+    polygon_add_point(polygon, x1, y1);
+    polygon_add_point(polygon, x0, y1);
+    graph_add_polygon(graph, polygon);
+    polygon_unref(polygon);
+}
+
+// a zigzag corridor of n_walls walls with the gap alternating top and bottom, some clutter in each chamber
+static Graph* bench_corridor(CtsAllocator* alloc, int n_walls) {
+    bench_seed = 7;
+    Graph* graph = graph_new(alloc);
+    for(int i = 0; i < n_walls; i++) {
+        double x = 40 * i + 20;
+        if(i % 2) {
+            bench_add_box(alloc, graph, x, 10, x + 2, 100);
+        }
+        else {
+            bench_add_box(alloc, graph, x, 0, x + 2, 90);
+        }
+        for(int k = 0; k < 3; k++) {
+            double cx = x + 8 + bench_rand(22);
+            double cy = 15 + bench_rand(70);
+            bench_add_box(alloc, graph, cx, cy, cx + 3, cy + 3);
+        }
+    }
+    graph_set_start_point(graph, point_new_with_coords(alloc, 5, 50));
+    graph_set_end_point(graph, point_new_with_coords(alloc, 40 * n_walls + 30, 50));
+    return graph;
+}
+
+static size_t bench_edge_count(Graph* graph) {
+    size_t edges = 0;
+    for(size_t i = 0; i < cts_array_get_length(graph->adjacency); i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+        edges += cts_slist_get_length(n->adjacent_points);
+    }
+    return edges;
+}
+
+// obstacle graph build time for 1 .. n_cores threads
+static void bench_thread_scaling(CtsAllocator* alloc, int cells) {
+    static const char* mode_names[] = { "brute force", "sweep" };
+    size_t n_cores = visibility_parallel_thread_count(0);
+
+    printf("thread scaling, %dx%d obstacles\n", cells, cells);
+    for(int mode = GRAPH_VISIBILITY_BRUTE_FORCE; mode <= GRAPH_VISIBILITY_SWEEP; mode++) {
+        double t_single = 0;
+        size_t n_threads = 1;
+        while(n_threads <= n_cores) {
+            Graph* graph = bench_scene(alloc, cells);
+            graph_set_visibility_mode(graph, (GraphVisibilityMode)mode);
+            graph_set_thread_count(graph, n_threads);
+
+            double t0 = bench_now();
+            graph_calculate_visibility(graph);
+            double t = bench_now() - t0;
+            if(n_threads == 1) {
+                t_single = t;
+            }
+
+            printf("  %-12s threads=%-3zu V=%-6zu edges=%-8zu %8.3fs  speedup %.2fx\n",
+                mode_names[mode], n_threads, cts_array_get_length(graph->adjacency),
+                bench_edge_count(graph), t, t_single / t);
+            graph_unref(graph);
+
+            // doubling each step, always finishing with every core
+            if((n_threads < n_cores) && (n_threads * 2 > n_cores)) {
+                n_threads = n_cores;
+            }
+            else {
+                n_threads *= 2;
+            }
+        }
+    }
+}
+
+// is_visible over every obstacle vertex pair with each segment kernel the CPU supports
+static void bench_segment_kernels(CtsAllocator* alloc, int cells) {
+    static const char* kernel_names[] = { "scalar", "sse2", "avx2" };
+
+    Graph* graph = bench_scene(alloc, cells);
+    graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+    graph_set_spatial_index(graph, false);
+    graph_calculate_visibility(graph);
+    size_t n = graph->n_obstacle_vertices;
+
+    printf("segment kernels, %zu sight lines against %zu edges\n", n * n, graph->obstacle_edges->length);
+    double t_scalar = 0;
+    for(int kernel = SEGMENT_BATCH_SCALAR; kernel <= (int)segment_batch_detect_kernel(); kernel++) {
+        segment_batch_set_kernel(graph->obstacle_edges, (SegmentBatchKernel)kernel);
+
+        size_t n_visible = 0;
+        double t0 = bench_now();
+        for(size_t i = 0; i < n; i++) {
+            AdjacencyNode* a = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+            for(size_t j = 0; j < n; j++) {
+                AdjacencyNode* b = (AdjacencyNode*)cts_array_get(graph->adjacency, j);
+                n_visible += is_visible(graph, a, b);
+            }
+        }
+        double t = bench_now() - t0;
+        if(kernel == SEGMENT_BATCH_SCALAR) {
+            t_scalar = t;
+        }
+        printf("  %-8s visible=%-8zu %8.3fs  speedup %.2fx\n", kernel_names[kernel], n_visible, t, t_scalar / t);
+    }
+    graph_unref(graph);
+}
+
+// brute force build with and without the obstacle grid
+static void bench_spatial_index(CtsAllocator* alloc, int cells) {
+    printf("spatial index, %dx%d obstacles\n", cells, cells);
+    double t_plain = 0;
+    for(int grid = 0; grid <= 1; grid++) {
+        Graph* graph = bench_scene(alloc, cells);
+        graph_set_spatial_index(graph, grid);
+
+        double t0 = bench_now();
+        graph_calculate_visibility(graph);
+        double t = bench_now() - t0;
+        if(!grid) {
+            t_plain = t;
+        }
+        printf("  %-8s edges=%-8zu polygons skipped=%-10zu %8.3fs  speedup %.2fx\n", grid ? "grid" : "no grid",
+            bench_edge_count(graph), graph_get_polygons_skipped(graph), t, t_plain / t);
+        graph_unref(graph);
+    }
+}
+
+// graph_get_path over the adjacency lists and over the frozen CSR copy
+static void bench_path_query(CtsAllocator* alloc, int cells) {
+    static const int n_queries = 20;
+    Graph* graph = bench_scene(alloc, cells);
+    graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+    graph_calculate_visibility(graph);
+
+    printf("path query, %dx%d obstacles, %d queries\n", cells, cells, n_queries);
+    double t_lists = 0;
+    for(int frozen = 0; frozen <= 1; frozen++) {
+        if(frozen && !graph_freeze(graph)) {
+            printf("  freezing failed\n");
+            break;
+        }
+        size_t length = 0;
+        double t0 = bench_now();
+        for(int q = 0; q < n_queries; q++) {
+            CtsArray* path = graph_get_path(graph);
+            length = cts_array_get_length(path);
+            cts_array_unref(path);
+        }
+        double t = (bench_now() - t0) / n_queries;
+        if(!frozen) {
+            t_lists = t;
+        }
+        printf("  %-8s path=%-4zu %8.2fms  speedup %.2fx\n", frozen ? "csr" : "lists", length, t * 1000, t_lists / t);
+    }
+    graph_unref(graph);
+}
+
+static double bench_expansions(Graph* graph, int n_queries, size_t* expanded) {
+    size_t total = 0;
+    double t0 = bench_now();
+    for(int q = 0; q < n_queries; q++) {
+        CtsArray* path = graph_get_path(graph);
+        total += graph_get_expanded_count(graph);
+        cts_array_unref(path);
+    }
+    double t = bench_now() - t0;
+    *expanded = total / n_queries;
+    return total / t;
+}
+
+static void bench_open_set(CtsAllocator* alloc, int cells) {
+    Graph* graph = bench_scene(alloc, cells);
+    graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+    graph_calculate_visibility(graph);
+
+    printf("A* open set, %dx%d obstacles\n", cells, cells);
+    size_t expanded;
+    double rate = bench_expansions(graph, 5, &expanded);
+    printf("  %-24s expanded=%-6zu %12.0f expansions/s\n", "lists, priority queue", expanded, rate);
+    if(!graph_freeze(graph)) {
+        printf("  freezing failed\n");
+        graph_unref(graph);
+        return;
+    }
+    graph_set_path_queue(graph, PATH_SEARCH_LAZY_HEAP);
+    rate = bench_expansions(graph, 200, &expanded);
+    printf("  %-24s expanded=%-6zu %12.0f expansions/s\n", "csr, lazy heap", expanded, rate);
+    graph_set_path_queue(graph, PATH_SEARCH_INDEXED_HEAP);
+    rate = bench_expansions(graph, 200, &expanded);
+    printf("  %-24s expanded=%-6zu %12.0f expansions/s\n", "csr, indexed heap", expanded, rate);
+    graph_unref(graph);
+}
+
+// full against reduced visibility graph: build time, links and frozen A* per query
+static void bench_reduced(CtsAllocator* alloc, int cells) {
+    printf("reduced visibility graph, %dx%d obstacles\n", cells, cells);
+    for(int reduced = 0; reduced <= 1; reduced++) {
+        Graph* graph = bench_scene(alloc, cells);
+        graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+        graph_set_reduced(graph, reduced);
+        graph_set_freeze(graph, true);
+        double t0 = bench_now();
+        graph_calculate_visibility(graph);
+        double t_build = bench_now() - t0;
+
+        size_t expanded;
+        double rate = bench_expansions(graph, 200, &expanded);
+        CtsArray* path = graph_get_path(graph);
+        double length = 0;
+        for(size_t i = 1; i < cts_array_get_length(path); i++) {
+            Point* a = (Point*)cts_array_get(path, i - 1);
+            Point* b = (Point*)cts_array_get(path, i);
+            length += hypot(a->x - b->x, a->y - b->y);
+        }
+        printf("  %-8s edges=%-8zu build %8.3fs  expanded=%-6zu %8.1fus/query  length %.3f\n", reduced ? "reduced" : "full",
+            bench_edge_count(graph), t_build, expanded, expanded / rate * 1e6, length);
+        cts_array_unref(path);
+        graph_unref(graph);
+    }
+}
+
+static void bench_direction(Graph* graph, const char* name) {
+    graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+    graph_set_freeze(graph, true);
+    graph_calculate_visibility(graph);
+    printf("  %s\n", name);
+    for(int bidirectional = 0; bidirectional <= 1; bidirectional++) {
+        graph_set_bidirectional(graph, bidirectional);
+        size_t expanded;
+        double rate = bench_expansions(graph, 200, &expanded);
+        CtsArray* path = graph_get_path(graph);
+        printf("    %-14s path=%-4zu expanded=%-6zu %8.1fus/query\n", bidirectional ? "bidirectional" : "unidirectional",
+            cts_array_get_length(path), expanded, expanded / rate * 1e6);
+        cts_array_unref(path);
+    }
+    graph_unref(graph);
+}
+
+static void bench_bidirectional(CtsAllocator* alloc, int cells) {
+    printf("bidirectional A*\n");
+    bench_direction(bench_scene(alloc, cells), "open grid");
+    bench_direction(bench_corridor(alloc, cells * 4), "corridor");
+}
+
+static void bench_batch(CtsAllocator* alloc, int cells) {
+    enum { n_queries = 100 };
+    Point* starts[n_queries];
+    Point* goals[n_queries];
+    CtsArray* paths[n_queries];
+    for(int i = 0; i < n_queries; i++) {
+        starts[i] = point_new_with_coords(alloc, bench_rand(cells * 400) * 0.1, bench_rand(cells * 400) * 0.1);
+        goals[i] = point_new_with_coords(alloc, bench_rand(cells * 400) * 0.1, bench_rand(cells * 400) * 0.1);
+    }
+
+    printf("batch query, %dx%d obstacles, %d queries\n", cells, cells, n_queries);
+    // one endpoint recalculation per query, what calling find_path in a loop amounts to
+    Graph* graph = bench_scene(alloc, cells);
+    graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+    graph_set_freeze(graph, true);
+    graph_calculate_visibility(graph);
+    double t0 = bench_now();
+    for(int i = 0; i < n_queries; i++) {
+        graph_set_start_point(graph, point_new_with_coords(alloc, starts[i]->x, starts[i]->y));
+        graph_set_end_point(graph, point_new_with_coords(alloc, goals[i]->x, goals[i]->y));
+        graph_calculate_visibility(graph);
+        cts_array_unref(graph_get_path(graph));
+    }
+    double t_single = bench_now() - t0;
+    printf("  %-10s %8.3fs\n", "one by one", t_single);
+
+    size_t n_cores = visibility_parallel_thread_count(0);
+    for(size_t n_threads = 1; n_threads <= n_cores; n_threads *= 2) {
+        graph_set_thread_count(graph, n_threads);
+        t0 = bench_now();
+        bool ok = graph_get_paths_batch(graph, starts, goals, n_queries, paths);
+        double t = bench_now() - t0;
+        for(int i = 0; i < n_queries; i++) {
+            if(paths[i]) {
+                cts_array_unref(paths[i]);
+            }
+        }
+        printf("  batch %-4zu %8.3fs  speedup %.2fx%s\n", n_threads, t, t_single / t, ok ? "" : "  (failed)");
+    }
+
+    // all pairs table, built once and then only looked up
+    graph_set_thread_count(graph, 0);
+    t0 = bench_now();
+    PathTable* table = path_table_new_from_graph(alloc, graph);
+    double t_build = bench_now() - t0;
+    if(table && graph_set_path_table(graph, table)) {
+        printf("  table build %8.3fs  %zu vertices, %zu bytes\n", t_build, table->n_vertices,
+            table->n_vertices * table->n_vertices * (sizeof(float) + sizeof(uint32_t)));
+        graph_set_thread_count(graph, 1);
+        t0 = bench_now();
+        bool ok = graph_get_paths_batch(graph, starts, goals, n_queries, paths);
+        double t = bench_now() - t0;
+        for(int i = 0; i < n_queries; i++) {
+            if(paths[i]) {
+                cts_array_unref(paths[i]);
+            }
+        }
+        printf("  table 1    %8.3fs  speedup %.2fx%s\n", t, t_single / t, ok ? "" : "  (failed)");
+        graph_set_path_table(graph, NULL);
+    }
+    if(table) {
+        path_table_unref(table);
+    }
+    graph_unref(graph);
+    for(int i = 0; i < n_queries; i++) {
+        point_unref(starts[i]);
+        point_unref(goals[i]);
+    }
+}
+
+// the gift wrapping polygon_giftwrap used before the monotone chain, as a baseline
+static void bench_giftwrap_reference(Polygon* polygon) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)polygon);
+    size_t n = polygon_size(polygon);
+    if(n < 3) {
+        return;
+    }
+    size_t lmp = 0;
+    for(size_t i = 1; i < n; i++) {
+        if(polygon_get_point(polygon, i)->y <= polygon_get_point(polygon, lmp)->y) {
+            lmp = i;
+        }
+    }
+    size_t* hull = (size_t*)cts_allocator_alloc(alloc, n * sizeof(size_t));
+    size_t m = 0;
+    size_t p = lmp;
+    do {
+        hull[m++] = p;
+        size_t q = (p + 1) % n;
+        for(size_t i = 0; i < n; i++) {
+            Point* a = polygon_get_point(polygon, p);
+            Point* b = polygon_get_point(polygon, i);
+            Point* c = polygon_get_point(polygon, q);
+            if((b->y - a->y) * (c->x - b->x) - (b->x - a->x) * (c->y - b->y) < 0) {
+                q = i;
+            }
+        }
+        p = q;
+    } while(p != lmp);
+
+    CtsArray* arr = cts_array_new(alloc);
+    for(size_t i = 0; i < m; i++) {
+        Point* point = polygon_get_point(polygon, hull[i]);
+        point_ref(point);
+        cts_array_append(arr, point);
+    }
+    cts_array_free_full(polygon->points, NULL, (ArrayFreeFunc)cts_object_free);
+    cts_array_unref(polygon->points);
+    polygon->points = arr;
+    polygon->n_points = m;
+    cts_allocator_free(alloc, hull);
+}
+
+static Polygon* bench_point_cloud(CtsAllocator* alloc, size_t n, bool circle) {
+    bench_seed = 7;
+    Polygon* polygon = polygon_new(alloc);
+    for(size_t i = 0; i < n; i++) {
+        if(circle) {
+            // every point ends up on the hull, the worst case for gift wrapping
+            double a = 2 * M_PI * bench_rand(1 << 20) / (1 << 20);
+            polygon_add_point(polygon, 100 * cos(a), 100 * sin(a));
+        } else {
+            polygon_add_point(polygon, bench_rand(100000) * 0.001, bench_rand(100000) * 0.001);
+        }
+    }
+    return polygon;
+}
+
+// convex hull of random and circular point clouds, gift wrapping against polygon_giftwrap
+static void bench_hull(CtsAllocator* alloc) {
+    static const size_t sizes[] = { 100, 1000, 10000 };
+
+    printf("convex hull\n");
+    for(int circle = 0; circle <= 1; circle++) {
+        for(size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+            int reps = (int)(100000 / sizes[k]);
+            double t[2];
+            size_t hull_size[2];
+            for(int monotone = 0; monotone <= 1; monotone++) {
+                t[monotone] = 0;
+                for(int r = 0; r < reps; r++) {
+                    Polygon* polygon = bench_point_cloud(alloc, sizes[k], circle);
+                    double t0 = bench_now();
+                    if(monotone) {
+                        polygon_giftwrap(polygon);
+                    } else {
+                        bench_giftwrap_reference(polygon);
+                    }
+                    t[monotone] += bench_now() - t0;
+                    hull_size[monotone] = polygon_size(polygon);
+                    polygon_unref(polygon);
+                }
+                t[monotone] /= reps;
+            }
+            printf("  %-7s n=%-6zu hull=%zu/%-6zu gift wrap %9.6fs  monotone chain %9.6fs  speedup %.2fx\n",
+                circle ? "circle" : "random", sizes[k], hull_size[0], hull_size[1], t[0], t[1], t[0] / t[1]);
+        }
+    }
+}
+
+// a Point object per vertex against compact polygons: scene setup, obstacle graph build and hull
+static void bench_polygon_storage(CtsAllocator* alloc, int cells) {
+    printf("polygon storage, %dx%d obstacles\n", cells, cells);
+    for(int compact = 0; compact <= 1; compact++) {
+        double t0 = bench_now();
+        Graph* graph = bench_scene_with(alloc, cells, compact);
+        double t_scene = bench_now() - t0;
+        graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+        t0 = bench_now();
+        graph_calculate_visibility(graph);
+        double t_build = bench_now() - t0;
+        CtsArray* path = graph_get_path(graph);
+
+        double t_hull = 0;
+        for(int r = 0; r < 10; r++) {
+            bench_seed = 7;
+            Polygon* polygon = compact ? polygon_new_compact(alloc) : polygon_new(alloc);
+            for(int i = 0; i < 10000; i++) {
+                double a = 2 * M_PI * bench_rand(1 << 20) / (1 << 20);
+                polygon_add_point(polygon, 100 * cos(a), 100 * sin(a));
+            }
+            t0 = bench_now();
+            polygon_giftwrap(polygon);
+            t_hull += bench_now() - t0;
+            polygon_unref(polygon);
+        }
+        printf("  %-8s scene %8.4fs  build %8.3fs  hull of 10000 %8.5fs  path=%zu\n", compact ? "compact" : "points",
+            t_scene, t_build, t_hull / 10, cts_array_get_length(path));
+        cts_array_unref(path);
+        graph_unref(graph);
+    }
+}
+
+// counts the bytes and blocks that are live on it, for the memory report, and the calls made to it. a
+// realloc counts as an alloc and a free
+typedef struct BenchCountingAllocator {
+    CtsAllocator base;
+    size_t bytes;
+    size_t peak;
+    size_t calls;
+    size_t blocks;
+} BenchCountingAllocator;
+
+typedef union BenchAllocHeader {
+    size_t size;
+    max_align_t align;
+} BenchAllocHeader;
+
+static void* bench_counting_alloc(CtsAllocator* self, size_t size) {
+    BenchCountingAllocator* counting = (BenchCountingAllocator*)self;
+    BenchAllocHeader* header = (BenchAllocHeader*)malloc(sizeof(BenchAllocHeader) + size);
+    if(header == NULL) {
+        return NULL;
+    }
+    header->size = size;
+    __atomic_add_fetch(&counting->calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counting->blocks, 1, __ATOMIC_RELAXED);
+    size_t bytes = __atomic_add_fetch(&counting->bytes, size, __ATOMIC_RELAXED);
+    if(bytes > counting->peak) {
+        counting->peak = bytes;
+    }
+    return header + 1;
+}
+
+static void bench_counting_free(CtsAllocator* self, void* ptr) {
+    BenchCountingAllocator* counting = (BenchCountingAllocator*)self;
+    if(ptr == NULL) {
+        return;
+    }
+    BenchAllocHeader* header = (BenchAllocHeader*)ptr - 1;
+    __atomic_add_fetch(&counting->calls, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&counting->blocks, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&counting->bytes, header->size, __ATOMIC_RELAXED);
+    free(header);
+}
+
+static void* bench_counting_realloc(CtsAllocator* self, void* ptr, size_t size) {
+    void* moved = bench_counting_alloc(self, size);
+    if((moved != NULL) && (ptr != NULL)) {
+        size_t old_size = ((BenchAllocHeader*)ptr - 1)->size;
+        memcpy(moved, ptr, (old_size < size) ? old_size : size);
+        bench_counting_free(self, ptr);
+    }
+    return moved;
+}
+
+// bytes the scene, the obstacle graph and its frozen copy take, and the blocks the scene is made of,
+// each of which also costs the allocator its header. build with make FLOAT_COORDINATES=1 for the
+// float numbers
+static void bench_memory(int cells) {
+    printf("memory, %dx%d obstacles, %s coordinates, sizeof(Point) %zu\n", cells, cells,
+        (sizeof(Coord) == sizeof(float)) ? "float" : "double", sizeof(Point));
+    for(int compact = 0; compact <= 1; compact++) {
+        BenchCountingAllocator counting = { { bench_counting_alloc, bench_counting_realloc, bench_counting_free }, 0, 0, 0, 0 };
+        CtsAllocator* alloc = &counting.base;
+
+        Graph* graph = bench_scene_with(alloc, cells, compact);
+        size_t scene = counting.bytes;
+        size_t scene_blocks = counting.blocks;
+        graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+        graph_set_thread_count(graph, 1);
+        graph_calculate_visibility(graph);
+        size_t built = counting.bytes;
+        graph_freeze(graph);
+        size_t frozen = counting.bytes;
+        graph_unref(graph);
+        printf("  %-8s scene %8zu bytes in %5zu blocks  graph %8zu bytes  frozen copy %8zu bytes  peak %8zu bytes\n",
+            compact ? "compact" : "points", scene, scene_blocks, built - scene, frozen - built, counting.peak);
+    }
+}
+
+// allocator calls per query with a reserved PathQueryContext, after one warm up query: the same query
+// repeated, the end point moved and the visibility recalculated before each query, and queries between
+// two points over the obstacle graph
+static void bench_query_allocations(int cells) {
+    static const char* loop_names[] = { "repeat", "move end", "between" };
+    static const int n_queries = 100;
+    BenchCountingAllocator counting = { { bench_counting_alloc, bench_counting_realloc, bench_counting_free }, 0, 0, 0, 0 };
+    CtsAllocator* alloc = &counting.base;
+
+    Graph* graph = bench_scene(alloc, cells);
+    graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+    graph_calculate_visibility(graph);
+    PathQueryContext* context = path_query_context_new_for_graph(alloc, graph);
+    Point* start = point_new_with_coords(alloc, 0.5, 0.5);
+    Point* goal = point_new_with_coords(alloc, cells * 40 - 0.5, cells * 40 - 0.5);
+
+    printf("allocator calls per query, %dx%d obstacles\n", cells, cells);
+    for(int loop = 0; loop < 3; loop++) {
+        size_t length = 0;
+        size_t calls = 0;
+        for(int q = 0; q <= n_queries; q++) {
+            if(q == 1) {
+                calls = counting.calls;
+            }
+            CtsArray* path;
+            if(loop == 2) {
+                goal->y = cells * 40 - 0.5 - (q % 8);
+                path = graph_query_path_between(graph, context, start, goal);
+            }
+            else {
+                if(loop == 1) {
+                    graph->end_point->y = cells * 40 - 0.5 - (q % 8);
+                    graph_calculate_visibility(graph);
+                }
+                path = graph_query_path(graph, context);
+            }
+            length = (path != NULL) ? cts_array_get_length(path) : 0;
+        }
+        printf("  %-8s path=%-4zu %8.1f calls\n", loop_names[loop], length, (double)(counting.calls - calls) / n_queries);
+    }
+    point_unref(start);
+    point_unref(goal);
+    path_query_context_unref(context);
+    graph_unref(graph);
+}
+
+// largest single allocation the pool can still serve, a measure of how fragmented it is
+static size_t bench_largest_alloc(CtsAllocator* pool, size_t hi) {
+    size_t lo = 0;
+    while(lo < hi) {
+        size_t mid = (lo + hi + 1) / 2;
+        void* ptr = cts_allocator_alloc(pool, mid);
+        if(ptr != NULL) {
+            cts_allocator_free(pool, ptr);
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// alloc/free churn on a pool with n_live blocks kept alive, mixing small and large sizes so the pool
+// stays fragmented. with segregated free lists the time per pair should not depend on n_live
+static void bench_pool_churn(void) {
+    static const size_t pool_size = 512 * 1024 - 1024;
+    static const int n_ops = 200000;
+    static const int live_counts[] = { 64, 512, 2048 };
+    void** live = (void**)malloc(2048 * sizeof(void*));
+    char* pool_mem = (char*)malloc(pool_size);
+
+    printf("pool churn, %zu byte pool, %d alloc/free pairs\n", pool_size, n_ops);
+    for(size_t c = 0; c < sizeof(live_counts) / sizeof(live_counts[0]); c++) {
+        int n_live = live_counts[c];
+        CtsAllocator* pool = cts_allocator_from_pool(pool_mem, pool_size);
+        bench_seed = 7;
+        for(int i = 0; i < n_live; i++) {
+            live[i] = cts_allocator_alloc(pool, 8 + bench_rand(120));
+        }
+        size_t failed = 0;
+        double t0 = bench_now();
+        for(int op = 0; op < n_ops; op++) {
+            int i = bench_rand(n_live);
+            if(live[i] != NULL) {
+                cts_allocator_free(pool, live[i]);
+            }
+            size_t size = (bench_rand(16) == 0) ? 256 + bench_rand(1024) : 8 + bench_rand(120);
+            live[i] = cts_allocator_alloc(pool, size);
+            failed += (live[i] == NULL);
+        }
+        double t = bench_now() - t0;
+        size_t largest = bench_largest_alloc(pool, pool_size);
+        for(int i = 0; i < n_live; i++) {
+            if(live[i] != NULL) {
+                cts_allocator_free(pool, live[i]);
+            }
+        }
+        printf("  live %-5d %8.1fns per pair  failed %zu  largest free %zu bytes\n", n_live, t / n_ops * 1e9, failed, largest);
+    }
+    free(pool_mem);
+    free(live);
+}
+
+// a planner given a pool of tens of MB, which takes the 32 bit block index variant. the pool isn't
+// thread safe so everything runs on one thread
+static void bench_large_pool(int cells) {
+    static const size_t pool_size = 64 * 1024 * 1024;
+    static const int n_queries = 20;
+    char* pool_mem = (char*)malloc(pool_size);
+
+    printf("large pool, %dx%d obstacles, %zuMB pool, %d queries\n", cells, cells, pool_size >> 20, n_queries);
+    for(int use_pool = 0; use_pool <= 1; use_pool++) {
+        CtsAllocator* alloc = use_pool ? cts_allocator_from_pool(pool_mem, pool_size) : cts_allocator_get_default();
+        double t0 = bench_now();
+        Graph* graph = bench_scene(alloc, cells);
+        graph_set_visibility_mode(graph, GRAPH_VISIBILITY_SWEEP);
+        graph_set_thread_count(graph, 1);
+        graph_calculate_visibility(graph);
+        double t_build = bench_now() - t0;
+
+        size_t length = 0;
+        t0 = bench_now();
+        for(int q = 0; q < n_queries; q++) {
+            CtsArray* path = graph_get_path(graph);
+            length = (path != NULL) ? cts_array_get_length(path) : 0;
+            if(path != NULL) {
+                cts_array_unref(path);
+            }
+        }
+        double t_query = (bench_now() - t0) / n_queries;
+        graph_unref(graph);
+        printf("  %-8s build %8.2fms  query %8.2fms  path=%zu\n", use_pool ? "pool" : "malloc", t_build * 1000, t_query * 1000, length);
+    }
+    free(pool_mem);
+}
+
+// per query scratch: allocate n_objects small objects then give them all back, the way a search does
+static void bench_arena(void) {
+    static const int n_rounds = 2000;
+    static const int n_objects = 1000;
+    static const size_t pool_size = 512 * 1024 - 1024;
+    void** objects = (void**)malloc(n_objects * sizeof(void*));
+    char* pool_mem = (char*)malloc(pool_size);
+    CtsAllocator* parent = cts_allocator_get_default();
+
+    printf("scratch, %d rounds of %d allocations\n", n_rounds, n_objects);
+    for(int kind = 0; kind < 3; kind++) {
+        CtsAllocator* alloc = (kind == 0) ? parent :
+            (kind == 1) ? cts_allocator_from_pool(pool_mem, pool_size) : cts_allocator_arena_new(parent, 4096);
+        double t0 = bench_now();
+        for(int round = 0; round < n_rounds; round++) {
+            if(kind == 2) {
+                CtsArenaMark mark = cts_allocator_arena_mark(alloc);
+                for(int i = 0; i < n_objects; i++) {
+                    objects[i] = cts_allocator_alloc(alloc, 24 + (i & 31));
+                }
+                cts_allocator_arena_release_to_mark(alloc, mark);
+            } else {
+                for(int i = 0; i < n_objects; i++) {
+                    objects[i] = cts_allocator_alloc(alloc, 24 + (i & 31));
+                }
+                for(int i = 0; i < n_objects; i++) {
+                    cts_allocator_free(alloc, objects[i]);
+                }
+            }
+        }
+        double t = (bench_now() - t0) / ((double)n_rounds * n_objects);
+        printf("  %-8s %6.1fns per allocation\n", (kind == 0) ? "malloc" : (kind == 1) ? "pool" : "arena", t * 1e9);
+        if(kind == 2) {
+            cts_allocator_arena_delete(alloc);
+        }
+    }
+    free(pool_mem);
+    free(objects);
+}
+
+#ifndef VISIBILITY_NO_THREADS
+// the baseline for bench_thread_alloc, every call takes one mutex in front of the pool
+typedef struct BenchLockedAllocator {
+    CtsAllocator allocator;
+    CtsAllocator* parent;
+    pthread_mutex_t lock;
+} BenchLockedAllocator;
+
+static void* bench_locked_alloc(CtsAllocator* self, size_t size) {
+    BenchLockedAllocator* locked = (BenchLockedAllocator*)self;
+    pthread_mutex_lock(&locked->lock);
+    void* ptr = locked->parent->alloc(locked->parent, size);
+    pthread_mutex_unlock(&locked->lock);
+    return ptr;
+}
+
+static void* bench_locked_realloc(CtsAllocator* self, void* ptr, size_t size) {
+    BenchLockedAllocator* locked = (BenchLockedAllocator*)self;
+    pthread_mutex_lock(&locked->lock);
+    ptr = locked->parent->realloc(locked->parent, ptr, size);
+    pthread_mutex_unlock(&locked->lock);
+    return ptr;
+}
+
+static void bench_locked_free(CtsAllocator* self, void* ptr) {
+    BenchLockedAllocator* locked = (BenchLockedAllocator*)self;
+    pthread_mutex_lock(&locked->lock);
+    locked->parent->free(locked->parent, ptr);
+    pthread_mutex_unlock(&locked->lock);
+}
+
+typedef struct BenchAllocWorker {
+    CtsAllocator* alloc;
+    Graph* graph; // NULL for allocator churn, otherwise the worker runs path queries on it
+    unsigned int seed;
+    bool cached; // alloc is a thread safe allocator with stats
+    size_t failed;
+    CtsAllocatorStats stats;
+} BenchAllocWorker;
+
+static void* bench_alloc_worker(void* data) {
+    static const int n_ops = 200000;
+    static const int n_live = 256;
+    static const int n_queries = 100;
+    BenchAllocWorker* worker = (BenchAllocWorker*)data;
+    CtsAllocator* alloc = worker->alloc;
+
+    if(worker->graph != NULL) {
+        for(int q = 0; q < n_queries; q++) {
+            CtsArray* path = graph_get_path(worker->graph);
+            if(path != NULL) {
+                cts_array_unref(path);
+            }
+            else {
+                worker->failed++;
+            }
+        }
+    }
+    else {
+        void* live[256] = { NULL };
+        unsigned int seed = worker->seed;
+        for(int op = 0; op < n_ops; op++) {
+            seed = seed * 1103515245u + 12345u;
+            int i = (seed >> 8) % n_live;
+            if(live[i] != NULL) {
+                cts_allocator_free(alloc, live[i]);
+            }
+            size_t size = ((seed >> 20) % 16 == 0) ? 256 + (seed >> 4) % 1024 : 8 + (seed >> 12) % 120;
+            live[i] = cts_allocator_alloc(alloc, size);
+            worker->failed += (live[i] == NULL);
+        }
+        for(int i = 0; i < n_live; i++) {
+            if(live[i] != NULL) {
+                cts_allocator_free(alloc, live[i]);
+            }
+        }
+    }
+    if(worker->cached) {
+        cts_allocator_thread_safe_get_stats(alloc, &worker->stats);
+    }
+    return NULL;
+}
+
+// runs n_threads workers against alloc and returns the wall time. with cells > 0 every worker gets its own
+// cells x cells scene built from alloc on this thread, so the graphs are freed by another thread than the
+// one that searched them
+static double bench_alloc_run(CtsAllocator* alloc, bool cached, size_t n_threads, int cells, BenchAllocWorker* workers) {
+    pthread_t* threads = (pthread_t*)malloc(n_threads * sizeof(pthread_t));
+    for(size_t t = 0; t < n_threads; t++) {
+        memset(&workers[t], 0, sizeof(BenchAllocWorker));
+        workers[t].alloc = alloc;
+        workers[t].seed = 7 + (unsigned int)t;
+        workers[t].cached = cached;
+        if(cells > 0) {
+            bench_seed = 7 + (unsigned int)t;
+            workers[t].graph = bench_scene(alloc, cells);
+            graph_set_thread_count(workers[t].graph, 1);
+            graph_calculate_visibility(workers[t].graph);
+        }
+    }
+    double t0 = bench_now();
+    for(size_t t = 0; t < n_threads; t++) {
+        pthread_create(&threads[t], NULL, bench_alloc_worker, &workers[t]);
+    }
+    for(size_t t = 0; t < n_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    double elapsed = bench_now() - t0;
+    for(size_t t = 0; t < n_threads; t++) {
+        if(workers[t].graph != NULL) {
+            graph_unref(workers[t].graph);
+        }
+    }
+    free(threads);
+    return elapsed;
+}
+
+// many threads allocating from one shared pool, once behind a single mutex and once through the thread
+// safe allocator that caches small blocks per thread. the cached one should keep scaling with the thread
+// count where the mutex serialises every call
+static void bench_thread_alloc(int cells) {
+    static const size_t pool_size = 32 * 1024 * 1024;
+    static const char* kind_names[] = { "mutex", "cached" };
+    size_t n_cores = visibility_parallel_thread_count(0);
+    char* pool_mem = (char*)malloc(pool_size);
+    BenchAllocWorker* workers = (BenchAllocWorker*)malloc(n_cores * sizeof(BenchAllocWorker));
+    int scene_cells = (cells < 6) ? cells : 6;
+
+    printf("shared pool, %zuMB, 1 .. %zu threads\n", pool_size >> 20, n_cores);
+    for(int planner = 0; planner <= 1; planner++) {
+        for(int kind = 0; kind <= 1; kind++) {
+            double t_single = 0;
+            size_t n_threads = 1;
+            while(n_threads <= n_cores) {
+                CtsAllocator* pool = cts_allocator_from_pool(pool_mem, pool_size);
+                BenchLockedAllocator locked;
+                CtsAllocator* alloc;
+                if(kind == 0) {
+                    locked.allocator.alloc = bench_locked_alloc;
+                    locked.allocator.realloc = bench_locked_realloc;
+                    locked.allocator.free = bench_locked_free;
+                    locked.parent = pool;
+                    pthread_mutex_init(&locked.lock, NULL);
+                    alloc = &locked.allocator;
+                }
+                else {
+                    alloc = cts_allocator_thread_safe_new(pool);
+                }
+
+                double t = bench_alloc_run(alloc, kind == 1, n_threads, planner ? scene_cells : 0, workers);
+                if(n_threads == 1) {
+                    t_single = t;
+                }
+                CtsAllocatorStats total = { 0, 0, 0, 0 };
+                size_t failed = 0;
+                for(size_t w = 0; w < n_threads; w++) {
+                    failed += workers[w].failed;
+                    total.allocs += workers[w].stats.allocs;
+                    total.cache_hits += workers[w].stats.cache_hits;
+                    total.locked_calls += workers[w].stats.locked_calls;
+                }
+                // the same work per thread, so perfect scaling keeps the wall time flat
+                printf("  %-7s %-6s threads=%-3zu %8.2fms  throughput %.2fx",
+                    planner ? "planner" : "churn", kind_names[kind], n_threads, t * 1000, t_single * n_threads / t);
+                if(kind == 1) {
+                    printf("  allocs %zu  cache hits %.1f%%  locked %zu",
+                        total.allocs, total.allocs ? 100.0 * total.cache_hits / total.allocs : 0.0, total.locked_calls);
+                }
+                printf("  failed %zu\n", failed);
+
+                if(kind == 0) {
+                    pthread_mutex_destroy(&locked.lock);
+                }
+                else {
+                    cts_allocator_thread_safe_delete(alloc);
+                }
+
+                if((n_threads < n_cores) && (n_threads * 2 > n_cores)) {
+                    n_threads = n_cores;
+                }
+                else {
+                    n_threads *= 2;
+                }
+            }
+        }
+    }
+    free(workers);
+    free(pool_mem);
+}
+#endif
+
+int main(int argc, char** argv) {
+    int cells = (argc > 1) ? atoi(argv[1]) : 12;
+
+    cts_allocator_init_default();
+    CtsAllocator* alloc = cts_allocator_get_default();
+
+    bench_thread_scaling(alloc, cells);
+    bench_segment_kernels(alloc, cells);
+    bench_spatial_index(alloc, cells);
+    bench_path_query(alloc, cells);
+    bench_open_set(alloc, cells);
+    bench_reduced(alloc, cells);
+    bench_bidirectional(alloc, cells);
+    bench_batch(alloc, cells);
+    bench_hull(alloc);
+    bench_polygon_storage(alloc, cells);
+    bench_memory(cells);
+    bench_query_allocations(cells);
+    bench_pool_churn();
+    bench_large_pool(cells);
+    bench_arena();
+#ifndef VISIBILITY_NO_THREADS
+    bench_thread_alloc(cells);
+#endif
+    return 0;
+}
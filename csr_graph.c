@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include "csr_graph.h"
+#include "visibility_graph.h"
+
+CTS_DEFINE_TYPE(CtsBase, cts_base, CsrGraph, csr_graph)
+
+struct VertexRef {
+    Point* point;
+    size_t index;
+};
+typedef struct VertexRef VertexRef;
+
+bool csr_graph_construct(CsrGraph* self) {
+    self->n_vertices = 0;
+    self->n_edges = 0;
+    self->points = NULL;
+    self->offsets = NULL;
+    self->refs = NULL;
+    self->neighbors = NULL;
+    self->lengths = NULL;
+    self->vertices_capacity = 0;
+    self->edges_capacity = 0;
+    return true;
+}
+
+static void csr_graph_free_vertices(CsrGraph* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if(self->points) {
+        cts_allocator_free(alloc, self->points);
+        self->points = NULL;
+    }
+    if(self->offsets) {
+        cts_allocator_free(alloc, self->offsets);
+        self->offsets = NULL;
+    }
+    if(self->refs) {
+        cts_allocator_free(alloc, self->refs);
+        self->refs = NULL;
+    }
+    self->vertices_capacity = 0;
+}
+
+static void csr_graph_free_edges(CsrGraph* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if(self->neighbors) {
+        cts_allocator_free(alloc, self->neighbors);
+        self->neighbors = NULL;
+    }
+    if(self->lengths) {
+        cts_allocator_free(alloc, self->lengths);
+        self->lengths = NULL;
+    }
+    self->edges_capacity = 0;
+}
+
+void csr_graph_destruct(CsrGraph* self) {
+    csr_graph_free_vertices(self);
+    csr_graph_free_edges(self);
+}
+
+static bool csr_graph_reserve(CsrGraph* csr, size_t n_vertices, size_t n_edges) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)csr);
+    if(n_vertices > csr->vertices_capacity) {
+        csr_graph_free_vertices(csr);
+        csr->points = (Point**)cts_allocator_alloc(alloc, sizeof(Point*) * n_vertices);
+        csr->offsets = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * (n_vertices + 1));
+        csr->refs = (VertexRef*)cts_allocator_alloc(alloc, sizeof(VertexRef) * n_vertices);
+        if(!csr->points || !csr->offsets || !csr->refs) {
+            csr_graph_free_vertices(csr);
+            return false;
+        }
+        csr->vertices_capacity = n_vertices;
+    }
+    if(n_edges > csr->edges_capacity) {
+        csr_graph_free_edges(csr);
+        // a little headroom, the start and end links change between queries
+        size_t capacity = n_edges + n_edges / 8 + 16;
+        csr->neighbors = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * capacity);
+        csr->lengths = (double*)cts_allocator_alloc(alloc, sizeof(double) * capacity);
+        if(!csr->neighbors || !csr->lengths) {
+            csr_graph_free_edges(csr);
+            return false;
+        }
+        csr->edges_capacity = capacity;
+    }
+    return true;
+}
+
+static int compare_vertex_refs(const void* pa, const void* pb) {
+    const VertexRef* a = (const VertexRef*)pa;
+    const VertexRef* b = (const VertexRef*)pb;
+    if(a->point < b->point) return -1;
+    if(a->point > b->point) return 1;
+    return 0;
+}
+
+static size_t links_used(AdjacencyNode* n, bool static_only) {
+    return static_only ? n->n_static : cts_slist_get_length(n->adjacent_points);
+}
+
+static bool build(CsrGraph* csr, CtsArray* adjacency, size_t n_vertices, bool static_only) {
+    size_t n_edges = 0;
+    for(size_t i = 0; i < n_vertices; i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(adjacency, i);
+        n_edges += links_used(n, static_only);
+    }
+    if(!csr_graph_reserve(csr, n_vertices, n_edges)) {
+        return false;
+    }
+
+    // lists hold points, a sorted table turns them back into vertex indices
+    VertexRef* refs = csr->refs;
+    for(size_t i = 0; i < n_vertices; i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(adjacency, i);
+        refs[i].point = n->root;
+        refs[i].index = i;
+        csr->points[i] = n->root;
+    }
+    qsort(refs, n_vertices, sizeof(VertexRef), compare_vertex_refs);
+
+    bool r = true;
+    size_t k = 0;
+    for(size_t i = 0; (i < n_vertices) && r; i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(adjacency, i);
+        csr->offsets[i] = k;
+
+        size_t n_links = links_used(n, static_only);
+        struct CtsSListNode* node = cts_slist_first_node(n->adjacent_points);
+        for(size_t j = 0; (j < n_links) && (node != NULL); j++, node = cts_slist_node_next(node)) {
+            VertexRef key = { (Point*)cts_slist_node_get(node), 0 };
+            VertexRef* found = (VertexRef*)bsearch(&key, refs, n_vertices, sizeof(VertexRef), compare_vertex_refs);
+            if(found == NULL) {
+                r = false;
+                break;
+            }
+            csr->neighbors[k] = found->index;
+            csr->lengths[k] = heuristic(n->root, key.point);
+            k++;
+        }
+    }
+    csr->offsets[n_vertices] = k;
+    csr->n_vertices = r ? n_vertices : 0;
+    csr->n_edges = r ? k : 0;
+    return r;
+}
+
+bool csr_graph_build(CsrGraph* csr, CtsArray* adjacency) {
+    return build(csr, adjacency, cts_array_get_length(adjacency), false);
+}
+
+bool csr_graph_build_static(CsrGraph* csr, CtsArray* adjacency, size_t n_vertices) {
+    if(n_vertices > cts_array_get_length(adjacency)) {
+        return false;
+    }
+    return build(csr, adjacency, n_vertices, true);
+}
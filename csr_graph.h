@@ -0,0 +1,33 @@
+#ifndef CSR_GRAPH_H
+#define CSR_GRAPH_H
+
+#include <Cts/cts.h>
+#include "polygon.h"
+
+/*
+ * Compressed sparse row copy of the visibility graph.
+ *
+ * Vertex i is entry i of the graph's adjacency array. Its neighbours are
+ * neighbors[offsets[i]] .. neighbors[offsets[i + 1] - 1], in the same order as its adjacency list,
+ * and lengths[k] is the euclidean length of the edge to neighbors[k]. The arrays are reused when the
+ * graph is frozen again, so refreezing after every query doesn't allocate once they're big enough.
+ */
+
+CTS_BEGIN_DECLARE_TYPE(CtsBase, CsrGraph, csr_graph)
+size_t n_vertices;
+size_t n_edges;
+Point** points; // n_vertices
+size_t* offsets; // n_vertices + 1
+struct VertexRef* refs; // n_vertices, the points sorted by address for mapping links back to indices
+size_t* neighbors; // n_edges
+double* lengths; // n_edges
+size_t vertices_capacity;
+size_t edges_capacity;
+CTS_END_DECLARE_TYPE(CsrGraph, csr_graph)
+
+// adjacency is the graph's array of AdjacencyNode*. fails if a list refers to a point that isn't a vertex
+bool csr_graph_build(CsrGraph* csr, CtsArray* adjacency);
+// only the first n_vertices nodes and the first n_static links of each, the obstacle graph without start and end
+bool csr_graph_build_static(CsrGraph* csr, CtsArray* adjacency, size_t n_vertices);
+
+#endif
@@ -0,0 +1,230 @@
+#include <math.h>
+#include "obstacle_grid.h"
+
+CTS_DEFINE_TYPE(CtsBase, cts_base, ObstacleGrid, obstacle_grid)
+
+// called for each cell a segment passes, returning false stops the walk
+typedef bool (*GridCellFunc)(ObstacleGrid* grid, size_t cell, void* data);
+
+bool obstacle_grid_construct(ObstacleGrid* self) {
+    self->min_x = 0;
+    self->min_y = 0;
+    self->max_x = 0;
+    self->max_y = 0;
+    self->cell_size = 1;
+    self->epsilon = 0;
+    self->n_cols = 0;
+    self->n_rows = 0;
+    self->cell_start = NULL;
+    self->usable = false;
+    self->edges = segment_batch_new(cts_base_get_allocator((CtsBase*)self));
+    if(self->edges == NULL) {
+        return false;
+    }
+    return true;
+}
+
+void obstacle_grid_destruct(ObstacleGrid* self) {
+    if(self->cell_start) {
+        cts_allocator_free(cts_base_get_allocator((CtsBase*)self), self->cell_start);
+    }
+    segment_batch_unref(self->edges);
+}
+
+static double grid_max(double a, double b) {
+    return (a > b)? a : b;
+}
+
+static double grid_min(double a, double b) {
+    return (a < b)? a : b;
+}
+
+static size_t cell_index(double v, double min, double cell_size, size_t n) {
+    double c = floor((v - min) / cell_size);
+    if(!(c >= 0)) {
+        return 0;
+    }
+    if(c >= (double)n) {
+        return n - 1;
+    }
+    return (size_t)c;
+}
+
+static bool visit_cells(ObstacleGrid* grid, double ax, double ay, double bx, double by, GridCellFunc func, void* data) {
+    // rounding in the walk grows with the coordinates of the segment, not just the grid
+    double eps = grid->epsilon + 1e-9 * grid_max(grid_max(fabs(ax), fabs(ay)), grid_max(fabs(bx), fabs(by)));
+
+    if(ay > by) {
+        double t = ax; ax = bx; bx = t;
+        t = ay; ay = by; by = t;
+    }
+    double seg_min_x = grid_min(ax, bx);
+    double seg_max_x = grid_max(ax, bx);
+    if((by + eps < grid->min_y) || (ay - eps > grid->max_y) ||
+        (seg_max_x + eps < grid->min_x) || (seg_min_x - eps > grid->max_x)) {
+        return true;
+    }
+
+    size_t row0 = cell_index(ay - eps, grid->min_y, grid->cell_size, grid->n_rows);
+    size_t row1 = cell_index(by + eps, grid->min_y, grid->cell_size, grid->n_rows);
+    double dy = by - ay;
+
+    for(size_t r = row0; r <= row1; r++) {
+        // part of the segment inside this row, widened by eps
+        double x_lo = seg_min_x;
+        double x_hi = seg_max_x;
+        if(dy > 0) {
+            double y0 = grid->min_y + r * grid->cell_size - eps;
+            double y1 = grid->min_y + (r + 1) * grid->cell_size + eps;
+            double t0 = (grid_max(y0, ay) - ay) / dy;
+            double t1 = (grid_min(y1, by) - ay) / dy;
+            double xa = ax + (bx - ax) * t0;
+            double xb = ax + (bx - ax) * t1;
+            x_lo = grid_max(grid_min(xa, xb), seg_min_x);
+            x_hi = grid_min(grid_max(xa, xb), seg_max_x);
+        }
+
+        size_t col0 = cell_index(x_lo - eps, grid->min_x, grid->cell_size, grid->n_cols);
+        size_t col1 = cell_index(x_hi + eps, grid->min_x, grid->cell_size, grid->n_cols);
+        for(size_t c = col0; c <= col1; c++) {
+            if(!func(grid, r * grid->n_cols + c, data)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+typedef struct GridFill {
+    size_t edge;
+    size_t* slots; // edge index for every entry, NULL while counting
+} GridFill;
+
+static bool count_cell(ObstacleGrid* grid, size_t cell, void* data) {
+    GridFill* fill = (GridFill*)data;
+    if(fill->slots == NULL) {
+        grid->cell_start[cell + 1]++;
+    }
+    else {
+        // cell_start[cell] is used as the write cursor and ends up at the start of the next cell
+        fill->slots[grid->cell_start[cell]++] = fill->edge;
+    }
+    return true;
+}
+
+static bool obstacle_grid_setup(ObstacleGrid* grid, SegmentBatch* source) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)grid);
+    size_t n_edges = source->length;
+    if(n_edges < OBSTACLE_GRID_MIN_EDGES) {
+        return true;
+    }
+
+    grid->min_x = grid->max_x = source->x1[0];
+    grid->min_y = grid->max_y = source->y1[0];
+    for(size_t i = 0; i < n_edges; i++) {
+        double xs[2] = { source->x1[i], source->x2[i] };
+        double ys[2] = { source->y1[i], source->y2[i] };
+        for(int k = 0; k < 2; k++) {
+            if(!isfinite(xs[k]) || !isfinite(ys[k])) {
+                return true;
+            }
+            grid->min_x = grid_min(grid->min_x, xs[k]);
+            grid->max_x = grid_max(grid->max_x, xs[k]);
+            grid->min_y = grid_min(grid->min_y, ys[k]);
+            grid->max_y = grid_max(grid->max_y, ys[k]);
+        }
+    }
+
+    // about one cell per edge, without letting a thin extent explode the number of cells
+    double w = grid->max_x - grid->min_x;
+    double h = grid->max_y - grid->min_y;
+    double cell_size = grid_max(sqrt(w * h / n_edges), grid_max(w, h) / n_edges);
+    if(!(cell_size > 0)) {
+        cell_size = 1;
+    }
+    grid->cell_size = cell_size;
+    grid->n_cols = (size_t)(w / cell_size) + 1;
+    grid->n_rows = (size_t)(h / cell_size) + 1;
+    grid->epsilon = cell_size * 1e-6 + 1e-9 * grid_max(grid_max(fabs(grid->min_x), fabs(grid->max_x)),
+        grid_max(fabs(grid->min_y), fabs(grid->max_y)));
+
+    size_t n_cells = grid->n_cols * grid->n_rows;
+    grid->cell_start = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * (n_cells + 1));
+    if(grid->cell_start == NULL) {
+        return false;
+    }
+    for(size_t c = 0; c <= n_cells; c++) {
+        grid->cell_start[c] = 0;
+    }
+
+    GridFill fill = { 0, NULL };
+    for(fill.edge = 0; fill.edge < n_edges; fill.edge++) {
+        visit_cells(grid, source->x1[fill.edge], source->y1[fill.edge], source->x2[fill.edge], source->y2[fill.edge], count_cell, &fill);
+    }
+    for(size_t c = 0; c < n_cells; c++) {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    size_t n_entries = grid->cell_start[n_cells];
+
+    fill.slots = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * n_entries);
+    if(fill.slots == NULL) {
+        return false;
+    }
+    for(fill.edge = 0; fill.edge < n_edges; fill.edge++) {
+        visit_cells(grid, source->x1[fill.edge], source->y1[fill.edge], source->x2[fill.edge], source->y2[fill.edge], count_cell, &fill);
+    }
+    // the cursors moved every cell_start one cell ahead
+    for(size_t c = n_cells; c > 0; c--) {
+        grid->cell_start[c] = grid->cell_start[c - 1];
+    }
+    grid->cell_start[0] = 0;
+
+    bool r = segment_batch_reserve(grid->edges, n_entries);
+    for(size_t i = 0; (i < n_entries) && r; i++) {
+        r = segment_batch_add(grid->edges, source->from[fill.slots[i]], source->to[fill.slots[i]]);
+    }
+    cts_allocator_free(alloc, fill.slots);
+    grid->usable = r;
+    return r;
+}
+
+ObstacleGrid* obstacle_grid_new_from_batch(CtsAllocator* alloc, SegmentBatch* edges) {
+    ObstacleGrid* grid = obstacle_grid_new(alloc);
+    if(grid == NULL) {
+        return NULL;
+    }
+    if(!obstacle_grid_setup(grid, edges)) {
+        obstacle_grid_unref(grid);
+        return NULL;
+    }
+    // copies share the kernel of the source batch
+    segment_batch_set_kernel(grid->edges, edges->kernel);
+    return grid;
+}
+
+bool obstacle_grid_is_usable(ObstacleGrid* grid) {
+    return grid->usable;
+}
+
+typedef struct GridQuery {
+    Point* from;
+    Point* to;
+    bool hit;
+} GridQuery;
+
+static bool query_cell(ObstacleGrid* grid, size_t cell, void* data) {
+    GridQuery* query = (GridQuery*)data;
+    query->hit = segment_batch_intersects_range(grid->edges, grid->cell_start[cell], grid->cell_start[cell + 1],
+        query->from, query->to);
+    return !query->hit;
+}
+
+bool obstacle_grid_intersects_any(ObstacleGrid* grid, Point* from, Point* to) {
+    if(!isfinite(from->x) || !isfinite(from->y) || !isfinite(to->x) || !isfinite(to->y)) {
+        // every edge is in at least one cell, testing the copies gives the plain answer
+        return segment_batch_intersects_any(grid->edges, from, to);
+    }
+    GridQuery query = { from, to, false };
+    visit_cells(grid, from->x, from->y, to->x, to->y, query_cell, &query);
+    return query.hit;
+}
@@ -0,0 +1,45 @@
+#ifndef OBSTACLE_GRID_H
+#define OBSTACLE_GRID_H
+
+#include <Cts/cts.h>
+#include "segment_batch.h"
+
+/*
+ * Uniform grid over the obstacle edges, so a sight line is only tested against the edges in the
+ * cells it passes through instead of every edge.
+ *
+ * The cell size is picked so there are about as many cells as edges. Every edge is copied into
+ * each cell it crosses and the copies are stored cell by cell in a SegmentBatch, so the edges of a
+ * cell are one contiguous range for the SIMD kernels. Cells are walked row by row along the
+ * segment (a scanline form of DDA) and the walk is padded by a small epsilon both when edges are
+ * inserted and when sight lines are traced, so rounding can never skip a cell where the two
+ * actually touch. The answer matches segment_batch_intersects_any() over all edges, except that
+ * edges far away from the sight line are never tested: the rounding in orientation() can report a
+ * crossing for disjoint segments that lie on (nearly) the same line, the grid doesn't.
+ *
+ * Small obstacle sets aren't worth a grid, obstacle_grid_is_usable() is false for them and for
+ * edges with non-finite coordinates.
+ */
+
+#define OBSTACLE_GRID_MIN_EDGES 64
+
+CTS_BEGIN_DECLARE_TYPE(CtsBase, ObstacleGrid, obstacle_grid)
+double min_x;
+double min_y;
+double max_x;
+double max_y;
+double cell_size;
+double epsilon;
+size_t n_cols;
+size_t n_rows;
+size_t* cell_start; // edges of cell c are cell_start[c] .. cell_start[c + 1] - 1
+SegmentBatch* edges;
+bool usable;
+CTS_END_DECLARE_TYPE(ObstacleGrid, obstacle_grid)
+
+ObstacleGrid* obstacle_grid_new_from_batch(CtsAllocator* alloc, SegmentBatch* edges);
+bool obstacle_grid_is_usable(ObstacleGrid* grid);
+// only valid for usable grids
+bool obstacle_grid_intersects_any(ObstacleGrid* grid, Point* from, Point* to);
+
+#endif
@@ -0,0 +1,365 @@
+#include <math.h>
+#include <string.h>
+#include "path_query.h"
+#include "path_table.h"
+#include "visibility_parallel.h"
+
+#ifndef VISIBILITY_NO_THREADS
+#include <pthread.h>
+#endif
+
+CTS_DEFINE_TYPE(CtsBase, cts_base, PathQueryContext, path_query_context)
+
+bool path_query_context_construct(PathQueryContext* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    self->start_links = NULL;
+    self->goal_links = NULL;
+    self->goal_vertices = NULL;
+    self->links_capacity = 0;
+    self->search = path_search_new(alloc);
+    self->path = cts_array_new(alloc);
+    return (self->search != NULL) && (self->path != NULL);
+}
+
+static void free_links(PathQueryContext* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if(self->start_links) {
+        cts_allocator_free(alloc, self->start_links);
+        self->start_links = NULL;
+    }
+    if(self->goal_links) {
+        cts_allocator_free(alloc, self->goal_links);
+        self->goal_links = NULL;
+    }
+    if(self->goal_vertices) {
+        cts_allocator_free(alloc, self->goal_vertices);
+        self->goal_vertices = NULL;
+    }
+    self->links_capacity = 0;
+}
+
+void path_query_context_destruct(PathQueryContext* self) {
+    free_links(self);
+    if(self->search) {
+        path_search_unref(self->search);
+    }
+    if(self->path) {
+        cts_array_unref(self->path);
+    }
+}
+
+PathQueryContext* path_query_context_new_for_graph(CtsAllocator* alloc, Graph* graph) {
+    PathQueryContext* context = path_query_context_new(alloc);
+    if(context == NULL) {
+        return NULL;
+    }
+    if(!path_query_context_reserve(context, graph)) {
+        path_query_context_unref(context);
+        return NULL;
+    }
+    return context;
+}
+
+static bool reserve_links(PathQueryContext* context, size_t n) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)context);
+    if(n <= context->links_capacity) {
+        return true;
+    }
+    free_links(context);
+    context->start_links = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * n);
+    context->goal_links = (double*)cts_allocator_alloc(alloc, sizeof(double) * n);
+    context->goal_vertices = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * n);
+    if(!context->start_links || !context->goal_links || !context->goal_vertices) {
+        free_links(context);
+        return false;
+    }
+    context->links_capacity = n;
+    return true;
+}
+
+bool path_query_context_reserve(PathQueryContext* context, Graph* graph) {
+    path_search_set_bidirectional(context->search, graph->bidirectional_search);
+    // obstacle vertices plus start and end, a path visits each at most once
+    size_t n_vertices = graph->n_obstacle_vertices + 2;
+    if(n_vertices < cts_array_get_length(graph->adjacency)) {
+        n_vertices = cts_array_get_length(graph->adjacency);
+    }
+    return path_search_reserve(context->search, n_vertices) &&
+        cts_array_reserve(context->path, n_vertices) &&
+        reserve_links(context, graph->n_obstacle_vertices);
+}
+
+CtsArray* graph_query_path(Graph* graph, PathQueryContext* context) {
+    cts_array_clear(context->path);
+    graph->n_expanded = 0;
+    if(!graph->csr_valid && !graph_freeze(graph)) {
+        return NULL;
+    }
+
+    // start and end are the last two vertices
+    size_t n_vertices = graph->csr->n_vertices;
+    if(n_vertices < 2) {
+        return context->path;
+    }
+    PathSearch* search = context->search;
+    path_search_set_queue(search, graph->path_queue);
+    path_search_set_bidirectional(search, graph->bidirectional_search);
+    bool found = path_search_find(search, graph->csr, n_vertices - 2, n_vertices - 1);
+    graph->n_expanded = search->n_expanded;
+    if(found && !path_search_append_path(search, graph->csr, n_vertices - 1, context->path)) {
+        cts_array_clear(context->path);
+        return NULL;
+    }
+    return context->path;
+}
+
+// cheapest start - a ~> b - goal over the table, a seen from start and b from goal
+static bool query_table(PathTable* table, CsrGraph* csr, PathQueryContext* context, const PathEndpoints* endpoints, size_t n_goal_vertices) {
+    size_t n = table->n_vertices;
+    double best = endpoints->direct ? heuristic(endpoints->start, endpoints->goal) : INFINITY;
+    size_t best_a = PATH_SEARCH_NO_VERTEX;
+    size_t best_b = PATH_SEARCH_NO_VERTEX;
+
+    for(size_t i = 0; i < endpoints->n_start_links; i++) {
+        size_t a = endpoints->start_links[i];
+        double to_a = heuristic(endpoints->start, csr->points[a]);
+        if(to_a >= best) {
+            continue;
+        }
+        const float* row = &table->distances[a * n];
+        for(size_t j = 0; j < n_goal_vertices; j++) {
+            size_t b = context->goal_vertices[j];
+            double cost = to_a + row[b] + endpoints->goal_links[b];
+            if(cost < best) {
+                best = cost;
+                best_a = a;
+                best_b = b;
+            }
+        }
+    }
+    if(isinf(best)) {
+        return true;
+    }
+
+    CtsArray* path = context->path;
+    bool r = cts_array_append(path, endpoints->start);
+    if(best_a != PATH_SEARCH_NO_VERTEX) {
+        // a path has at most n vertices, more steps means a damaged table
+        size_t v = best_a;
+        for(size_t steps = 0; (v != best_b) && r; steps++) {
+            r = (steps < n) && cts_array_append(path, csr->points[v]);
+            v = table->next[v * n + best_b];
+            r = r && (v < n);
+        }
+        r = r && cts_array_append(path, csr->points[best_b]);
+    }
+    return r && cts_array_append(path, endpoints->goal);
+}
+
+// expects graph_freeze_obstacles and path_query_context_reserve to have succeeded, doesn't touch the
+// graph so it can run on several threads at once
+static bool query_between(Graph* graph, PathQueryContext* context, Point* start, Point* goal) {
+    CsrGraph* csr = graph->obstacle_csr;
+    PathEndpoints endpoints = { start, goal, context->start_links, 0, context->goal_links, false };
+    size_t n_goal_vertices = 0;
+
+    for(size_t v = 0; v < csr->n_vertices; v++) {
+        Point* p = csr->points[v];
+        // obstacle_csr has the same vertex order as adjacency
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, v);
+        if(graph_link_is_tangent(graph, n, start) && graph_points_visible(graph, start, p)) {
+            context->start_links[endpoints.n_start_links++] = v;
+        }
+        context->goal_links[v] = -1;
+        if(graph_link_is_tangent(graph, n, goal) && graph_points_visible(graph, p, goal)) {
+            context->goal_links[v] = heuristic(p, goal);
+            context->goal_vertices[n_goal_vertices++] = v;
+        }
+    }
+    endpoints.direct = graph_points_visible(graph, start, goal);
+
+    cts_array_clear(context->path);
+    if(graph->path_table) {
+        context->search->n_expanded = 0;
+        if(!query_table(graph->path_table, csr, context, &endpoints, n_goal_vertices)) {
+            cts_array_clear(context->path);
+            return false;
+        }
+        return true;
+    }
+    if(path_search_find_between(context->search, csr, &endpoints)) {
+        return path_search_append_path_between(context->search, csr, &endpoints, context->path);
+    }
+    return true;
+}
+
+CtsArray* graph_query_path_between(Graph* graph, PathQueryContext* context, Point* start, Point* goal) {
+    cts_array_clear(context->path);
+    graph->n_expanded = 0;
+    if(!graph_freeze_obstacles(graph) || !path_query_context_reserve(context, graph)) {
+        return NULL;
+    }
+    bool r = query_between(graph, context, start, goal);
+    graph->n_expanded = context->search->n_expanded;
+    if(!r) {
+        cts_array_clear(context->path);
+        return NULL;
+    }
+    return context->path;
+}
+
+typedef struct BatchWorker {
+    struct Batch* batch;
+    PathQueryContext* context;
+#ifndef VISIBILITY_NO_THREADS
+    pthread_t thread;
+#endif
+    bool started;
+} BatchWorker;
+
+typedef struct Batch {
+    Graph* graph;
+    Point** starts;
+    Point** goals;
+    CtsArray** paths;
+    size_t n;
+    size_t next; // next query to claim
+    bool failed;
+#ifndef VISIBILITY_NO_THREADS
+    // the result arrays grow through the graph's allocator, which isn't thread safe
+    pthread_mutex_t alloc_lock;
+#endif
+} Batch;
+
+static void lock_alloc(Batch* batch) {
+#ifndef VISIBILITY_NO_THREADS
+    pthread_mutex_lock(&batch->alloc_lock);
+#else
+    (void)batch;
+#endif
+}
+
+static void unlock_alloc(Batch* batch) {
+#ifndef VISIBILITY_NO_THREADS
+    pthread_mutex_unlock(&batch->alloc_lock);
+#else
+    (void)batch;
+#endif
+}
+
+static bool copy_path(Batch* batch, PathQueryContext* context, CtsArray* out) {
+    size_t length = cts_array_get_length(context->path);
+    lock_alloc(batch);
+    bool r = cts_array_reserve(out, length);
+    unlock_alloc(batch);
+    // reserved, so appending doesn't allocate
+    for(size_t i = 0; (i < length) && r; i++) {
+        r = cts_array_append(out, cts_array_get(context->path, i));
+    }
+    return r;
+}
+
+static void* run_batch_worker(void* data) {
+    BatchWorker* worker = (BatchWorker*)data;
+    Batch* batch = worker->batch;
+    while(true) {
+        size_t i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+        if(i >= batch->n) {
+            break;
+        }
+        if(!query_between(batch->graph, worker->context, batch->starts[i], batch->goals[i]) ||
+            !copy_path(batch, worker->context, batch->paths[i])) {
+            __atomic_store_n(&batch->failed, true, __ATOMIC_RELAXED);
+            lock_alloc(batch);
+            cts_array_unref(batch->paths[i]);
+            unlock_alloc(batch);
+            batch->paths[i] = NULL;
+        }
+    }
+    return NULL;
+}
+
+bool graph_get_paths_batch(Graph* graph, Point** starts, Point** goals, size_t n, CtsArray** paths) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)graph);
+    for(size_t i = 0; i < n; i++) {
+        paths[i] = NULL;
+    }
+    if(!graph_freeze_obstacles(graph)) {
+        return false;
+    }
+
+    size_t n_threads = visibility_parallel_thread_count(graph->n_threads);
+#ifdef VISIBILITY_NO_THREADS
+    n_threads = 1;
+#endif
+    if(n_threads > n) {
+        n_threads = n;
+    }
+    if(n_threads < 1) {
+        n_threads = 1;
+    }
+
+    // all memory is set up here, on the calling thread
+    BatchWorker* workers = (BatchWorker*)cts_allocator_alloc(alloc, sizeof(BatchWorker) * n_threads);
+    if(workers == NULL) {
+        return false;
+    }
+    memset(workers, 0, sizeof(BatchWorker) * n_threads);
+    // alloc_lock is initialised once the setup below has succeeded
+    Batch batch = {
+        .graph = graph,
+        .starts = starts,
+        .goals = goals,
+        .paths = paths,
+        .n = n,
+        .next = 0,
+        .failed = false,
+    };
+    bool r = true;
+    for(size_t i = 0; (i < n_threads) && r; i++) {
+        workers[i].batch = &batch;
+        workers[i].context = path_query_context_new_for_graph(alloc, graph);
+        r = (workers[i].context != NULL);
+    }
+    for(size_t i = 0; (i < n) && r; i++) {
+        paths[i] = cts_array_new(alloc);
+        r = (paths[i] != NULL);
+    }
+
+    if(r) {
+#ifndef VISIBILITY_NO_THREADS
+        pthread_mutex_init(&batch.alloc_lock, NULL);
+        // the calling thread is worker 0
+        for(size_t i = 1; i < n_threads; i++) {
+            workers[i].started = (pthread_create(&workers[i].thread, NULL, run_batch_worker, &workers[i]) == 0);
+        }
+        run_batch_worker(&workers[0]);
+        for(size_t i = 1; i < n_threads; i++) {
+            if(workers[i].started) {
+                pthread_join(workers[i].thread, NULL);
+            }
+        }
+        pthread_mutex_destroy(&batch.alloc_lock);
+#else
+        run_batch_worker(&workers[0]);
+#endif
+        r = !batch.failed;
+    }
+    else {
+        // setup failed, nothing was searched
+        for(size_t i = 0; i < n; i++) {
+            if(paths[i]) {
+                cts_array_unref(paths[i]);
+                paths[i] = NULL;
+            }
+        }
+    }
+
+    for(size_t i = 0; i < n_threads; i++) {
+        if(workers[i].context) {
+            path_query_context_unref(workers[i].context);
+        }
+    }
+    cts_allocator_free(alloc, workers);
+    return r;
+}
@@ -0,0 +1,49 @@
+#ifndef PATH_QUERY_H
+#define PATH_QUERY_H
+
+#include <Cts/cts.h>
+#include "visibility_graph.h"
+
+/*
+ * Scratch memory for repeated path queries.
+ *
+ * graph_get_path allocates the result array on every call, and on a graph that isn't frozen also a
+ * priority queue, three hash maps and a GraphNode per visited vertex. A PathQueryContext owns a
+ * PathSearch and a result array instead, both sized to the graph by path_query_context_reserve().
+ * After that graph_query_path() makes no allocator calls until the graph grows past the reserved size.
+ *
+ * graph_query_path() searches the frozen graph and freezes it first when needed. Freezing reuses the
+ * CsrGraph arrays, so only the first freeze allocates. Moving the start or end point still allocates
+ * in graph_calculate_visibility(), one list node per link of the moved points (see bench). Use
+ * graph_query_path_between() for a query loop that makes no allocator calls at all.
+ *
+ * graph_query_path_between() finds a path between any two points over the obstacle graph alone, only
+ * the visibility of the two points is computed per query. graph_get_paths_batch() runs many of those
+ * on graph->n_threads threads (see graph_set_thread_count), one context per thread. With a PathTable
+ * attached to the graph both look the path up instead of searching.
+ *
+ * The returned path belongs to the context and is overwritten by the next query. One context runs one
+ * query at a time, give each thread its own.
+ */
+
+CTS_BEGIN_DECLARE_TYPE(CtsBase, PathQueryContext, path_query_context)
+PathSearch* search;
+CtsArray* path; // Point*, start first
+size_t* start_links; // scratch for between queries, one entry per obstacle vertex
+double* goal_links;
+size_t* goal_vertices; // vertices that see the goal, for the table lookup
+size_t links_capacity;
+CTS_END_DECLARE_TYPE(PathQueryContext, path_query_context)
+
+// new context already reserved for graph, NULL if that fails
+PathQueryContext* path_query_context_new_for_graph(CtsAllocator* alloc, Graph* graph);
+bool path_query_context_reserve(PathQueryContext* context, Graph* graph);
+// path from the graph start point to its end point, empty if there is none. NULL if memory ran out
+CtsArray* graph_query_path(Graph* graph, PathQueryContext* context);
+// path from start to goal, which don't have to be the graph's start and end point
+CtsArray* graph_query_path_between(Graph* graph, PathQueryContext* context, Point* start, Point* goal);
+// paths[i] gets a new array with the path from starts[i] to goals[i], empty if there is none and NULL
+// if memory ran out. returns false if any query failed that way
+bool graph_get_paths_batch(Graph* graph, Point** starts, Point** goals, size_t n, CtsArray** paths);
+
+#endif
@@ -0,0 +1,627 @@
+#include <math.h>
+#include <string.h>
+#include "path_search.h"
+#include "visibility_graph.h"
+
+CTS_DEFINE_TYPE(CtsBase, cts_base, PathSearch, path_search)
+
+bool path_search_construct(PathSearch* self) {
+    self->capacity = 0;
+    self->g_cost = NULL;
+    self->parent = NULL;
+    self->reached = NULL;
+    self->closed = NULL;
+    self->generation = 0;
+    self->queue = PATH_SEARCH_LAZY_HEAP;
+    self->open = NULL;
+    self->heap = NULL;
+    self->heap_length = 0;
+    self->heap_capacity = 0;
+    self->n_expanded = 0;
+    self->bidirectional = false;
+    self->back_capacity = 0;
+    self->g_cost_back = NULL;
+    self->parent_back = NULL;
+    self->reached_back = NULL;
+    self->closed_back = NULL;
+    self->open_back = NULL;
+    self->meeting = PATH_SEARCH_NO_VERTEX;
+    self->back_root = PATH_SEARCH_NO_VERTEX;
+    self->n_expanded_forward = 0;
+    self->n_expanded_backward = 0;
+    return true;
+}
+
+static void path_search_free_arrays(PathSearch* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if(self->g_cost) {
+        cts_allocator_free(alloc, self->g_cost);
+        self->g_cost = NULL;
+    }
+    if(self->parent) {
+        cts_allocator_free(alloc, self->parent);
+        self->parent = NULL;
+    }
+    if(self->reached) {
+        cts_allocator_free(alloc, self->reached);
+        self->reached = NULL;
+    }
+    if(self->closed) {
+        cts_allocator_free(alloc, self->closed);
+        self->closed = NULL;
+    }
+    self->capacity = 0;
+}
+
+static void path_search_free_back_arrays(PathSearch* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if(self->g_cost_back) {
+        cts_allocator_free(alloc, self->g_cost_back);
+        self->g_cost_back = NULL;
+    }
+    if(self->parent_back) {
+        cts_allocator_free(alloc, self->parent_back);
+        self->parent_back = NULL;
+    }
+    if(self->reached_back) {
+        cts_allocator_free(alloc, self->reached_back);
+        self->reached_back = NULL;
+    }
+    if(self->closed_back) {
+        cts_allocator_free(alloc, self->closed_back);
+        self->closed_back = NULL;
+    }
+    self->back_capacity = 0;
+}
+
+void path_search_destruct(PathSearch* self) {
+    path_search_free_arrays(self);
+    path_search_free_back_arrays(self);
+    if(self->open) {
+        cts_indexed_heap_unref(self->open);
+    }
+    if(self->open_back) {
+        cts_indexed_heap_unref(self->open_back);
+    }
+    if(self->heap) {
+        cts_allocator_free(cts_base_get_allocator((CtsBase*)self), self->heap);
+    }
+}
+
+static bool reserve_arrays(PathSearch* search, size_t n_vertices) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)search);
+    if(n_vertices <= search->capacity) {
+        return true;
+    }
+    path_search_free_arrays(search);
+    search->g_cost = (double*)cts_allocator_alloc(alloc, sizeof(double) * n_vertices);
+    search->parent = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * n_vertices);
+    search->reached = (uint32_t*)cts_allocator_alloc(alloc, sizeof(uint32_t) * n_vertices);
+    search->closed = (uint32_t*)cts_allocator_alloc(alloc, sizeof(uint32_t) * n_vertices);
+    if(!search->g_cost || !search->parent || !search->reached || !search->closed) {
+        path_search_free_arrays(search);
+        return false;
+    }
+    // the generation keeps counting, the backward arrays may still hold stamps up to its current value
+    memset(search->reached, 0, sizeof(uint32_t) * n_vertices);
+    memset(search->closed, 0, sizeof(uint32_t) * n_vertices);
+    search->capacity = n_vertices;
+    return true;
+}
+
+// the backward search of bidirectional mode, stamped with the same generation as the forward arrays
+static bool reserve_back_arrays(PathSearch* search, size_t n_vertices) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)search);
+    if(n_vertices > search->back_capacity) {
+        path_search_free_back_arrays(search);
+        search->g_cost_back = (double*)cts_allocator_alloc(alloc, sizeof(double) * n_vertices);
+        search->parent_back = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * n_vertices);
+        search->reached_back = (uint32_t*)cts_allocator_alloc(alloc, sizeof(uint32_t) * n_vertices);
+        search->closed_back = (uint32_t*)cts_allocator_alloc(alloc, sizeof(uint32_t) * n_vertices);
+        if(!search->g_cost_back || !search->parent_back || !search->reached_back || !search->closed_back) {
+            path_search_free_back_arrays(search);
+            return false;
+        }
+        memset(search->reached_back, 0, sizeof(uint32_t) * n_vertices);
+        memset(search->closed_back, 0, sizeof(uint32_t) * n_vertices);
+        search->back_capacity = n_vertices;
+    }
+    if(search->open_back == NULL) {
+        search->open_back = cts_indexed_heap_new(alloc);
+    }
+    return (search->open_back != NULL) && cts_indexed_heap_reserve(search->open_back, n_vertices);
+}
+
+static void next_generation(PathSearch* search) {
+    search->meeting = PATH_SEARCH_NO_VERTEX;
+    search->back_root = PATH_SEARCH_NO_VERTEX;
+    search->generation++;
+    if(search->generation == 0) {
+        // wrapped around, old stamps could look current again
+        memset(search->reached, 0, sizeof(uint32_t) * search->capacity);
+        memset(search->closed, 0, sizeof(uint32_t) * search->capacity);
+        if(search->back_capacity > 0) {
+            memset(search->reached_back, 0, sizeof(uint32_t) * search->back_capacity);
+            memset(search->closed_back, 0, sizeof(uint32_t) * search->back_capacity);
+        }
+        search->generation = 1;
+    }
+}
+
+static bool heap_less(PathHeapEntry* a, PathHeapEntry* b) {
+    if(a->f_cost != b->f_cost) {
+        return a->f_cost < b->f_cost;
+    }
+    // on equal f prefer the vertex furthest along, it's closer to the goal
+    return a->g_cost > b->g_cost;
+}
+
+static bool heap_push(PathSearch* search, double f_cost, double g_cost, size_t vertex) {
+    if(search->heap_length == search->heap_capacity) {
+        CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)search);
+        size_t capacity = (search->heap_capacity == 0) ? 64 : search->heap_capacity * 2;
+        PathHeapEntry* heap = (PathHeapEntry*)cts_allocator_alloc(alloc, sizeof(PathHeapEntry) * capacity);
+        if(heap == NULL) {
+            return false;
+        }
+        if(search->heap) {
+            memcpy(heap, search->heap, sizeof(PathHeapEntry) * search->heap_length);
+            cts_allocator_free(alloc, search->heap);
+        }
+        search->heap = heap;
+        search->heap_capacity = capacity;
+    }
+
+    PathHeapEntry entry = { f_cost, g_cost, vertex };
+    size_t i = search->heap_length++;
+    while(i > 0) {
+        size_t up = (i - 1) / 2;
+        if(!heap_less(&entry, &search->heap[up])) {
+            break;
+        }
+        search->heap[i] = search->heap[up];
+        i = up;
+    }
+    search->heap[i] = entry;
+    return true;
+}
+
+static PathHeapEntry heap_pop(PathSearch* search) {
+    PathHeapEntry top = search->heap[0];
+    PathHeapEntry last = search->heap[--search->heap_length];
+    size_t n = search->heap_length;
+    size_t i = 0;
+    while(true) {
+        size_t child = 2 * i + 1;
+        if(child >= n) {
+            break;
+        }
+        if((child + 1 < n) && heap_less(&search->heap[child + 1], &search->heap[child])) {
+            child++;
+        }
+        if(!heap_less(&search->heap[child], &last)) {
+            break;
+        }
+        search->heap[i] = search->heap[child];
+        i = child;
+    }
+    if(n > 0) {
+        search->heap[i] = last;
+    }
+    return top;
+}
+
+void path_search_set_queue(PathSearch* search, PathSearchQueue queue) {
+    search->queue = queue;
+}
+
+void path_search_set_bidirectional(PathSearch* search, bool bidirectional) {
+    search->bidirectional = bidirectional;
+}
+
+// one direction of a search
+typedef struct SearchSide {
+    double* g_cost;
+    size_t* parent;
+    uint32_t* reached;
+    uint32_t* closed;
+    CtsIndexedHeap* open;
+    uint32_t generation;
+} SearchSide;
+
+static SearchSide forward_side(PathSearch* search) {
+    SearchSide side = { search->g_cost, search->parent, search->reached, search->closed, search->open, search->generation };
+    return side;
+}
+
+static SearchSide backward_side(PathSearch* search) {
+    SearchSide side = { search->g_cost_back, search->parent_back, search->reached_back, search->closed_back, search->open_back, search->generation };
+    return side;
+}
+
+// offers a path to vertex to through from with cost g_cost. h_cost is the heuristic at to
+static void relax_side(SearchSide* side, size_t from, size_t to, double g_cost, double h_cost) {
+    if(side->reached[to] != side->generation) {
+        side->reached[to] = side->generation;
+        side->g_cost[to] = g_cost;
+        side->parent[to] = from;
+        cts_indexed_heap_push(side->open, to, g_cost + h_cost);
+    }
+    else if((g_cost < side->g_cost[to]) && cts_indexed_heap_contains(side->open, to)) {
+        side->g_cost[to] = g_cost;
+        side->parent[to] = from;
+        cts_indexed_heap_decrease_key(side->open, to, g_cost + h_cost);
+    }
+}
+
+static void relax(PathSearch* search, size_t from, size_t to, double g_cost, double h_cost) {
+    SearchSide side = forward_side(search);
+    relax_side(&side, from, to, g_cost, h_cost);
+}
+
+// average of the distance to goal and the negated distance to start. consistent for both directions,
+// the backward search uses its negation, see find_bidirectional
+static double bidirectional_potential(Point* p, Point* start_point, Point* goal_point) {
+    return (heuristic(p, goal_point) - heuristic(p, start_point)) / 2;
+}
+
+static void start_side(SearchSide* side, size_t root, double h_cost) {
+    cts_indexed_heap_clear(side->open);
+    side->g_cost[root] = 0;
+    side->parent[root] = root;
+    side->reached[root] = side->generation;
+    cts_indexed_heap_push(side->open, root, h_cost);
+}
+
+// A* from both ends. With the potentials above, a vertex's forward and backward keys add up to the
+// length of the best path through it, so once the smallest keys of both queues add up to at least the
+// best path seen so far (mu) no better path is left and the search stops
+static bool find_bidirectional(PathSearch* search, CsrGraph* csr, size_t start, size_t goal) {
+    Point* start_point = csr->points[start];
+    Point* goal_point = csr->points[goal];
+    SearchSide sides[2] = { forward_side(search), backward_side(search) };
+    double sign[2] = { 1, -1 };
+    size_t* n_expanded[2] = { &search->n_expanded_forward, &search->n_expanded_backward };
+
+    search->back_root = goal;
+    start_side(&sides[0], start, bidirectional_potential(start_point, start_point, goal_point));
+    start_side(&sides[1], goal, -bidirectional_potential(goal_point, start_point, goal_point));
+
+    double mu = INFINITY;
+    if(start == goal) {
+        mu = 0;
+        search->meeting = start;
+    }
+    while(!cts_indexed_heap_is_empty(sides[0].open) && !cts_indexed_heap_is_empty(sides[1].open)) {
+        double top_forward = cts_indexed_heap_get_priority(sides[0].open, cts_indexed_heap_peek(sides[0].open));
+        double top_backward = cts_indexed_heap_get_priority(sides[1].open, cts_indexed_heap_peek(sides[1].open));
+        if(top_forward + top_backward >= mu) {
+            break;
+        }
+
+        // expand the side with the smaller open set
+        int d = (cts_indexed_heap_get_size(sides[0].open) <= cts_indexed_heap_get_size(sides[1].open)) ? 0 : 1;
+        SearchSide* side = &sides[d];
+        SearchSide* other = &sides[1 - d];
+        size_t v = cts_indexed_heap_pop(side->open);
+        side->closed[v] = side->generation;
+        (*n_expanded[d])++;
+
+        // the visibility graph is symmetric, so the backward search walks the same rows
+        double g_v = side->g_cost[v];
+        size_t row_end = csr->offsets[v + 1];
+        for(size_t k = csr->offsets[v]; k < row_end; k++) {
+            size_t neighbor = csr->neighbors[k];
+            if(side->closed[neighbor] == side->generation) {
+                continue;
+            }
+            double h_cost = sign[d] * bidirectional_potential(csr->points[neighbor], start_point, goal_point);
+            relax_side(side, v, neighbor, g_v + csr->lengths[k], h_cost);
+            if(other->reached[neighbor] == other->generation) {
+                double through = side->g_cost[neighbor] + other->g_cost[neighbor];
+                if(through < mu) {
+                    mu = through;
+                    search->meeting = neighbor;
+                }
+            }
+        }
+    }
+    search->n_expanded = search->n_expanded_forward + search->n_expanded_backward;
+    return search->meeting != PATH_SEARCH_NO_VERTEX;
+}
+
+static bool find_indexed(PathSearch* search, CsrGraph* csr, size_t start, size_t goal) {
+    CtsIndexedHeap* open = search->open;
+    uint32_t generation = search->generation;
+    Point* goal_point = csr->points[goal];
+
+    cts_indexed_heap_clear(open);
+    search->g_cost[start] = 0;
+    search->parent[start] = start;
+    search->reached[start] = generation;
+    cts_indexed_heap_push(open, start, heuristic(csr->points[start], goal_point));
+
+    while(!cts_indexed_heap_is_empty(open)) {
+        size_t v = cts_indexed_heap_pop(open);
+        search->closed[v] = generation;
+        search->n_expanded++;
+        if(v == goal) {
+            cts_indexed_heap_clear(open);
+            return true;
+        }
+
+        double g_v = search->g_cost[v];
+        size_t row_end = csr->offsets[v + 1];
+        for(size_t k = csr->offsets[v]; k < row_end; k++) {
+            size_t neighbor = csr->neighbors[k];
+            if(search->closed[neighbor] != generation) {
+                relax(search, v, neighbor, g_v + csr->lengths[k], heuristic(csr->points[neighbor], goal_point));
+            }
+        }
+    }
+    return false;
+}
+
+bool path_search_find_between(PathSearch* search, CsrGraph* csr, const PathEndpoints* endpoints) {
+    size_t start = csr->n_vertices;
+    size_t goal = start + 1;
+    search->n_expanded = 0;
+    if(!path_search_reserve(search, goal + 1)) {
+        return false;
+    }
+    next_generation(search);
+
+    CtsIndexedHeap* open = search->open;
+    uint32_t generation = search->generation;
+    Point* goal_point = endpoints->goal;
+
+    cts_indexed_heap_clear(open);
+    search->g_cost[start] = 0;
+    search->parent[start] = start;
+    search->reached[start] = generation;
+    cts_indexed_heap_push(open, start, heuristic(endpoints->start, goal_point));
+
+    while(!cts_indexed_heap_is_empty(open)) {
+        size_t v = cts_indexed_heap_pop(open);
+        search->closed[v] = generation;
+        search->n_expanded++;
+        if(v == goal) {
+            cts_indexed_heap_clear(open);
+            return true;
+        }
+
+        double g_v = search->g_cost[v];
+        if(v == start) {
+            for(size_t i = 0; i < endpoints->n_start_links; i++) {
+                size_t neighbor = endpoints->start_links[i];
+                Point* p = csr->points[neighbor];
+                relax(search, v, neighbor, g_v + heuristic(endpoints->start, p), heuristic(p, goal_point));
+            }
+            if(endpoints->direct) {
+                relax(search, v, goal, g_v + heuristic(endpoints->start, goal_point), 0);
+            }
+            continue;
+        }
+
+        size_t row_end = csr->offsets[v + 1];
+        for(size_t k = csr->offsets[v]; k < row_end; k++) {
+            size_t neighbor = csr->neighbors[k];
+            if(search->closed[neighbor] != generation) {
+                relax(search, v, neighbor, g_v + csr->lengths[k], heuristic(csr->points[neighbor], goal_point));
+            }
+        }
+        if(endpoints->goal_links[v] >= 0) {
+            relax(search, v, goal, g_v + endpoints->goal_links[v], 0);
+        }
+    }
+    return false;
+}
+
+bool path_search_reserve(PathSearch* search, size_t n_vertices) {
+    if(!reserve_arrays(search, n_vertices)) {
+        return false;
+    }
+    if(search->bidirectional && !reserve_back_arrays(search, n_vertices)) {
+        return false;
+    }
+    // also needed in lazy mode, between queries always use it
+    if(search->open == NULL) {
+        search->open = cts_indexed_heap_new(cts_base_get_allocator((CtsBase*)search));
+    }
+    return (search->open != NULL) && cts_indexed_heap_reserve(search->open, n_vertices);
+}
+
+bool path_search_find(PathSearch* search, CsrGraph* csr, size_t start, size_t goal) {
+    search->n_expanded = 0;
+    search->n_expanded_forward = 0;
+    search->n_expanded_backward = 0;
+    search->heap_length = 0;
+    if((start >= csr->n_vertices) || (goal >= csr->n_vertices) || !path_search_reserve(search, csr->n_vertices)) {
+        return false;
+    }
+    next_generation(search);
+
+    if(search->bidirectional) {
+        return find_bidirectional(search, csr, start, goal);
+    }
+
+    if(search->queue == PATH_SEARCH_INDEXED_HEAP) {
+        return find_indexed(search, csr, start, goal);
+    }
+
+    uint32_t generation = search->generation;
+    Point* goal_point = csr->points[goal];
+
+    search->g_cost[start] = 0;
+    search->parent[start] = start;
+    search->reached[start] = generation;
+    if(!heap_push(search, heuristic(csr->points[start], goal_point), 0, start)) {
+        return false;
+    }
+
+    while(search->heap_length > 0) {
+        PathHeapEntry entry = heap_pop(search);
+        size_t v = entry.vertex;
+        if((search->closed[v] == generation) || (entry.g_cost != search->g_cost[v])) {
+            // superseded by a cheaper push
+            continue;
+        }
+        search->closed[v] = generation;
+        search->n_expanded++;
+        if(v == goal) {
+            return true;
+        }
+
+        size_t row_end = csr->offsets[v + 1];
+        for(size_t k = csr->offsets[v]; k < row_end; k++) {
+            size_t neighbor = csr->neighbors[k];
+            if(search->closed[neighbor] == generation) {
+                continue;
+            }
+            double g_cost = entry.g_cost + csr->lengths[k];
+            if((search->reached[neighbor] == generation) && (g_cost >= search->g_cost[neighbor])) {
+                continue;
+            }
+            search->reached[neighbor] = generation;
+            search->g_cost[neighbor] = g_cost;
+            search->parent[neighbor] = v;
+            if(!heap_push(search, g_cost + heuristic(csr->points[neighbor], goal_point), g_cost, neighbor)) {
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+bool path_search_dijkstra(PathSearch* search, CsrGraph* csr, size_t source) {
+    search->n_expanded = 0;
+    if((source >= csr->n_vertices) || !path_search_reserve(search, csr->n_vertices)) {
+        return false;
+    }
+    next_generation(search);
+
+    CtsIndexedHeap* open = search->open;
+    uint32_t generation = search->generation;
+
+    cts_indexed_heap_clear(open);
+    search->g_cost[source] = 0;
+    search->parent[source] = source;
+    search->reached[source] = generation;
+    cts_indexed_heap_push(open, source, 0);
+
+    while(!cts_indexed_heap_is_empty(open)) {
+        size_t v = cts_indexed_heap_pop(open);
+        search->closed[v] = generation;
+        search->n_expanded++;
+
+        double g_v = search->g_cost[v];
+        size_t row_end = csr->offsets[v + 1];
+        for(size_t k = csr->offsets[v]; k < row_end; k++) {
+            size_t neighbor = csr->neighbors[k];
+            if(search->closed[neighbor] != generation) {
+                relax(search, v, neighbor, g_v + csr->lengths[k], 0);
+            }
+        }
+    }
+    return true;
+}
+
+bool path_search_get_distances(PathSearch* search, CsrGraph* csr, double* distances, size_t* predecessors) {
+    if(search->capacity < csr->n_vertices) {
+        return false;
+    }
+    for(size_t v = 0; v < csr->n_vertices; v++) {
+        bool reached = (search->closed[v] == search->generation);
+        distances[v] = reached ? search->g_cost[v] : INFINITY;
+        if(predecessors) {
+            predecessors[v] = reached ? search->parent[v] : PATH_SEARCH_NO_VERTEX;
+        }
+    }
+    return true;
+}
+
+static Point* vertex_point(CsrGraph* csr, const PathEndpoints* endpoints, size_t v) {
+    if((endpoints != NULL) && (v >= csr->n_vertices)) {
+        return (v == csr->n_vertices) ? endpoints->start : endpoints->goal;
+    }
+    return csr->points[v];
+}
+
+// start ~> meeting from the forward parents, then on to the goal along the backward parents
+static bool append_path_bidirectional(PathSearch* search, CsrGraph* csr, CtsArray* path) {
+    size_t first = cts_array_get_length(path);
+    size_t v = search->meeting;
+    while(true) {
+        if(!cts_array_append(path, csr->points[v])) {
+            return false;
+        }
+        if(search->parent[v] == v) {
+            break;
+        }
+        v = search->parent[v];
+    }
+    size_t last = cts_array_get_length(path) - 1;
+    while(first < last) {
+        cts_pointer tmp = cts_array_replace(path, first, cts_array_get(path, last));
+        cts_array_replace(path, last, tmp);
+        first++;
+        last--;
+    }
+
+    v = search->meeting;
+    while(search->parent_back[v] != v) {
+        v = search->parent_back[v];
+        if(!cts_array_append(path, csr->points[v])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool append_path(PathSearch* search, CsrGraph* csr, const PathEndpoints* endpoints, size_t goal, CtsArray* path) {
+    if((endpoints == NULL) && (search->meeting != PATH_SEARCH_NO_VERTEX) && (goal == search->back_root)) {
+        return append_path_bidirectional(search, csr, path);
+    }
+    if((goal >= search->capacity) || (search->closed[goal] != search->generation)) {
+        return false;
+    }
+    size_t first = cts_array_get_length(path);
+    size_t v = goal;
+    while(true) {
+        if(!cts_array_append(path, vertex_point(csr, endpoints, v))) {
+            return false;
+        }
+        if(search->parent[v] == v) {
+            break;
+        }
+        v = search->parent[v];
+    }
+
+    // the walk went goal to start
+    size_t last = cts_array_get_length(path) - 1;
+    while(first < last) {
+        cts_pointer tmp = cts_array_replace(path, first, cts_array_get(path, last));
+        cts_array_replace(path, last, tmp);
+        first++;
+        last--;
+    }
+    return true;
+}
+
+bool path_search_append_path(PathSearch* search, CsrGraph* csr, size_t goal, CtsArray* path) {
+    return append_path(search, csr, NULL, goal, path);
+}
+
+bool path_search_append_path_between(PathSearch* search, CsrGraph* csr, const PathEndpoints* endpoints, CtsArray* path) {
+    return append_path(search, csr, endpoints, csr->n_vertices + 1, path);
+}
+
+double path_search_get_cost(PathSearch* search, size_t goal) {
+    if((search->meeting != PATH_SEARCH_NO_VERTEX) && (goal == search->back_root)) {
+        return search->g_cost[search->meeting] + search->g_cost_back[search->meeting];
+    }
+    if((goal >= search->capacity) || (search->closed[goal] != search->generation)) {
+        return INFINITY;
+    }
+    return search->g_cost[goal];
+}
@@ -0,0 +1,133 @@
+#include <math.h>
+#include "path_smooth.h"
+
+typedef struct SmoothOutput {
+    PathSample* samples;
+    size_t capacity;
+    size_t count;
+    double spacing;
+    double carry; // distance travelled since the last resampled point
+} SmoothOutput;
+
+void path_smooth_options_init(PathSmoothOptions* options) {
+    options->clearance = 0;
+    options->remove_collinear = true;
+    options->collinear_epsilon = 1e-9;
+    options->spacing = 0;
+}
+
+static void emit(SmoothOutput* output, double x, double y) {
+    if(output->count < output->capacity) {
+        output->samples[output->count].x = x;
+        output->samples[output->count].y = y;
+    }
+    output->count++;
+}
+
+static Point* vertex(CtsArray* path, size_t i) {
+    return (Point*)cts_array_get(path, i);
+}
+
+static bool points_coincide(Point* a, Point* b) {
+    return (a->x == b->x) && (a->y == b->y);
+}
+
+// true if b lies on the segment a - c, within epsilon
+static bool is_collinear(Point* a, Point* b, Point* c, double epsilon) {
+    double dx = (double)c->x - a->x, dy = (double)c->y - a->y;
+    double length = sqrt(dx*dx + dy*dy);
+    if(length == 0) {
+        return points_coincide(a, b);
+    }
+    double cross = dx * ((double)b->y - a->y) - dy * ((double)b->x - a->x);
+    double along = dx * ((double)b->x - a->x) + dy * ((double)b->y - a->y);
+    return (fabs(cross) / length <= epsilon) && (along >= 0) && (along <= length * length);
+}
+
+// the vertex after kept vertex i that is kept too
+static size_t next_kept(CtsArray* path, size_t i, const PathSmoothOptions* options) {
+    size_t n = cts_array_get_length(path);
+    size_t j = i + 1;
+    while(j + 1 < n) {
+        if(points_coincide(vertex(path, j), vertex(path, i))) {
+            j++;
+        }
+        else if(options->remove_collinear && is_collinear(vertex(path, i), vertex(path, j), vertex(path, j + 1), options->collinear_epsilon)) {
+            j++;
+        }
+        else {
+            break;
+        }
+    }
+    return j;
+}
+
+// p moved clearance away from the corner it bends around on the way from a to b
+static PathSample offset_vertex(Point* a, Point* p, Point* b, double clearance) {
+    PathSample s = { p->x, p->y };
+    double ux = (double)a->x - p->x, uy = (double)a->y - p->y;
+    double vx = (double)b->x - p->x, vy = (double)b->y - p->y;
+    double lu = sqrt(ux*ux + uy*uy);
+    double lv = sqrt(vx*vx + vy*vy);
+    if((clearance <= 0) || (lu == 0) || (lv == 0)) {
+        return s;
+    }
+    // the obstacle sits inside the bend, between the two legs
+    double bx = ux / lu + vx / lv;
+    double by = uy / lu + vy / lv;
+    double lb = sqrt(bx*bx + by*by);
+    if(lb < 1e-12) {
+        // straight through, nothing to move away from
+        return s;
+    }
+    s.x -= bx / lb * clearance;
+    s.y -= by / lb * clearance;
+    return s;
+}
+
+static void emit_segment(SmoothOutput* output, PathSample a, PathSample b) {
+    if(output->spacing <= 0) {
+        emit(output, b.x, b.y);
+        return;
+    }
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double length = sqrt(dx*dx + dy*dy);
+    double t = output->spacing - output->carry;
+    while(t <= length) {
+        emit(output, a.x + dx * t / length, a.y + dy * t / length);
+        t += output->spacing;
+    }
+    output->carry = length - (t - output->spacing);
+}
+
+size_t path_smooth(CtsArray* path, const PathSmoothOptions* options, PathSample* out, size_t capacity) {
+    SmoothOutput output = { out, capacity, 0, options->spacing, 0 };
+    size_t n = cts_array_get_length(path);
+    if(n == 0) {
+        return 0;
+    }
+
+    PathSample last = { vertex(path, 0)->x, vertex(path, 0)->y };
+    emit(&output, last.x, last.y);
+    size_t i = 0;
+    while(i + 1 < n) {
+        size_t j = next_kept(path, i, options);
+        PathSample current = { vertex(path, j)->x, vertex(path, j)->y };
+        if(j + 1 < n) {
+            current = offset_vertex(vertex(path, i), vertex(path, j), vertex(path, next_kept(path, j, options)), options->clearance);
+        }
+        else if(points_coincide(vertex(path, j), vertex(path, i))) {
+            // the path ends in repeats of its last bend
+            break;
+        }
+        emit_segment(&output, last, current);
+        last = current;
+        i = j;
+    }
+
+    // resampling rarely lands exactly on the end
+    if((options->spacing > 0) && (output.carry > 1e-9 * options->spacing)) {
+        emit(&output, last.x, last.y);
+    }
+    return output.count;
+}
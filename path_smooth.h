@@ -0,0 +1,45 @@
+#ifndef PATH_SMOOTH_H
+#define PATH_SMOOTH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <Cts/cts.h>
+#include "polygon.h"
+
+/*
+ * Post-processing for the paths graph_get_path and friends return.
+ *
+ * Visibility graph paths are already taut: straight lines that bend only at obstacle corners. This
+ * turns one into a polyline for consumers that want something else:
+ *  - clearance: every bend is pushed this far away from the corner it wraps around, along the
+ *    bisector of the turn. The first and last points stay put. The moved legs aren't tested against
+ *    the obstacles again, so keep it below the margin the obstacles were built with.
+ *  - remove_collinear: bends closer than collinear_epsilon to the line through their neighbours are
+ *    dropped. Repeated points are always dropped.
+ *  - spacing: the result is resampled every spacing units along its length, always including the first
+ *    and last point. 0 keeps just the vertices.
+ *
+ * The output goes into a caller supplied buffer and nothing is allocated, so it's safe to run every
+ * frame on a pool allocator.
+ */
+
+typedef struct PathSample {
+    Coord x;
+    Coord y;
+} PathSample;
+
+typedef struct PathSmoothOptions {
+    double clearance;
+    bool remove_collinear;
+    double collinear_epsilon;
+    double spacing;
+} PathSmoothOptions;
+
+// no clearance, collinear points removed, no resampling
+void path_smooth_options_init(PathSmoothOptions* options);
+
+// writes at most capacity samples of the processed path (an array of Point*) to out and returns how
+// many the whole path takes, so a return value above capacity means the output was cut short
+size_t path_smooth(CtsArray* path, const PathSmoothOptions* options, PathSample* out, size_t capacity);
+
+#endif
@@ -0,0 +1,302 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "path_table.h"
+#include "path_search.h"
+#include "visibility_parallel.h"
+
+#ifndef VISIBILITY_NO_THREADS
+#include <pthread.h>
+#endif
+
+#define PATH_TABLE_MAGIC 0x54465045u // "EPFT"
+#define PATH_TABLE_VERSION 1u
+
+typedef struct PathTableHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t n_vertices;
+    uint64_t checksum;
+} PathTableHeader;
+
+CTS_DEFINE_TYPE(CtsBase, cts_base, PathTable, path_table)
+
+bool path_table_construct(PathTable* self) {
+    self->n_vertices = 0;
+    self->checksum = 0;
+    self->distances = NULL;
+    self->next = NULL;
+    return true;
+}
+
+static void path_table_free_arrays(PathTable* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    if(self->distances) {
+        cts_allocator_free(alloc, self->distances);
+        self->distances = NULL;
+    }
+    if(self->next) {
+        cts_allocator_free(alloc, self->next);
+        self->next = NULL;
+    }
+    self->n_vertices = 0;
+}
+
+void path_table_destruct(PathTable* self) {
+    path_table_free_arrays(self);
+}
+
+static bool path_table_resize(PathTable* table, size_t n_vertices) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)table);
+    path_table_free_arrays(table);
+    if((n_vertices >= PATH_TABLE_NO_VERTEX) || (n_vertices > SIZE_MAX / sizeof(float) / (n_vertices ? n_vertices : 1))) {
+        return false;
+    }
+    size_t n_pairs = n_vertices * n_vertices;
+    if(n_pairs > 0) {
+        table->distances = (float*)cts_allocator_alloc(alloc, sizeof(float) * n_pairs);
+        table->next = (uint32_t*)cts_allocator_alloc(alloc, sizeof(uint32_t) * n_pairs);
+        if(!table->distances || !table->next) {
+            path_table_free_arrays(table);
+            return false;
+        }
+    }
+    table->n_vertices = n_vertices;
+    return true;
+}
+
+// FNV-1a over the obstacle vertex coordinates, in adjacency order
+static uint64_t graph_checksum(Graph* graph) {
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < graph->n_obstacle_vertices; i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+        double xy[2] = { n->root->x, n->root->y };
+        const uint8_t* bytes = (const uint8_t*)xy;
+        for(size_t b = 0; b < sizeof(xy); b++) {
+            hash = (hash ^ bytes[b]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+bool path_table_matches(PathTable* table, Graph* graph) {
+    return (table->n_vertices == graph->n_obstacle_vertices) && (table->checksum == graph_checksum(graph));
+}
+
+typedef struct TableWorker {
+    struct TableBuild* build;
+    PathSearch* search;
+    size_t* first; // first hop from the source to each vertex
+#ifndef VISIBILITY_NO_THREADS
+    pthread_t thread;
+#endif
+    bool started;
+} TableWorker;
+
+typedef struct TableBuild {
+    PathTable* table;
+    CsrGraph* csr;
+    size_t next_source;
+    bool failed;
+} TableBuild;
+
+// row source of the table from one Dijkstra run
+static bool fill_row(TableBuild* build, TableWorker* worker, size_t source) {
+    PathSearch* search = worker->search;
+    CsrGraph* csr = build->csr;
+    size_t n = csr->n_vertices;
+    float* distances = &build->table->distances[source * n];
+    uint32_t* next = &build->table->next[source * n];
+    size_t* first = worker->first;
+
+    if(!path_search_dijkstra(search, csr, source)) {
+        return false;
+    }
+    for(size_t v = 0; v < n; v++) {
+        first[v] = PATH_SEARCH_NO_VERTEX;
+    }
+    first[source] = source;
+
+    for(size_t v = 0; v < n; v++) {
+        if(search->closed[v] != search->generation) {
+            distances[v] = INFINITY;
+            next[v] = PATH_TABLE_NO_VERTEX;
+            continue;
+        }
+        distances[v] = (float)search->g_cost[v];
+
+        // walk towards the source until the first hop is known, then label the walk with it
+        size_t u = v;
+        while((first[u] == PATH_SEARCH_NO_VERTEX) && (search->parent[u] != source)) {
+            u = search->parent[u];
+        }
+        size_t hop = (first[u] == PATH_SEARCH_NO_VERTEX) ? u : first[u];
+        for(u = v; first[u] == PATH_SEARCH_NO_VERTEX; u = search->parent[u]) {
+            first[u] = hop;
+        }
+        next[v] = (v == source) ? (uint32_t)source : (uint32_t)first[v];
+    }
+    return true;
+}
+
+static void* run_table_worker(void* data) {
+    TableWorker* worker = (TableWorker*)data;
+    TableBuild* build = worker->build;
+    while(true) {
+        size_t source = __atomic_fetch_add(&build->next_source, 1, __ATOMIC_RELAXED);
+        if(source >= build->csr->n_vertices) {
+            break;
+        }
+        if(!fill_row(build, worker, source)) {
+            __atomic_store_n(&build->failed, true, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    return NULL;
+}
+
+bool path_table_build(PathTable* table, Graph* graph) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)table);
+    if(!graph_freeze_obstacles(graph)) {
+        return false;
+    }
+    CsrGraph* csr = graph->obstacle_csr;
+    size_t n = csr->n_vertices;
+    if(!path_table_resize(table, n)) {
+        return false;
+    }
+    table->checksum = graph_checksum(graph);
+
+    size_t n_threads = visibility_parallel_thread_count(graph->n_threads);
+#ifdef VISIBILITY_NO_THREADS
+    n_threads = 1;
+#endif
+    if(n_threads > n) {
+        n_threads = n;
+    }
+    if(n_threads < 1) {
+        n_threads = 1;
+    }
+
+    // every worker's scratch is allocated here, the searches don't allocate once reserved
+    TableWorker* workers = (TableWorker*)cts_allocator_alloc(alloc, sizeof(TableWorker) * n_threads);
+    if(workers == NULL) {
+        return false;
+    }
+    memset(workers, 0, sizeof(TableWorker) * n_threads);
+    TableBuild build = { table, csr, 0, false };
+    bool r = true;
+    for(size_t i = 0; (i < n_threads) && r; i++) {
+        workers[i].build = &build;
+        workers[i].search = path_search_new(alloc);
+        workers[i].first = (size_t*)cts_allocator_alloc(alloc, sizeof(size_t) * (n + 1));
+        r = workers[i].search && workers[i].first && path_search_reserve(workers[i].search, n);
+    }
+
+    if(r) {
+#ifndef VISIBILITY_NO_THREADS
+        // the calling thread is worker 0
+        for(size_t i = 1; i < n_threads; i++) {
+            workers[i].started = (pthread_create(&workers[i].thread, NULL, run_table_worker, &workers[i]) == 0);
+        }
+        run_table_worker(&workers[0]);
+        for(size_t i = 1; i < n_threads; i++) {
+            if(workers[i].started) {
+                pthread_join(workers[i].thread, NULL);
+            }
+        }
+#else
+        run_table_worker(&workers[0]);
+#endif
+        r = !build.failed;
+    }
+
+    for(size_t i = 0; i < n_threads; i++) {
+        if(workers[i].search) {
+            path_search_unref(workers[i].search);
+        }
+        if(workers[i].first) {
+            cts_allocator_free(alloc, workers[i].first);
+        }
+    }
+    cts_allocator_free(alloc, workers);
+    if(!r) {
+        path_table_free_arrays(table);
+    }
+    return r;
+}
+
+PathTable* path_table_new_from_graph(CtsAllocator* alloc, Graph* graph) {
+    PathTable* table = path_table_new(alloc);
+    if(table == NULL) {
+        return NULL;
+    }
+    if(!path_table_build(table, graph)) {
+        path_table_unref(table);
+        return NULL;
+    }
+    return table;
+}
+
+bool path_table_save(PathTable* table, const char* filename) {
+    FILE* file = fopen(filename, "wb");
+    if(file == NULL) {
+        return false;
+    }
+    PathTableHeader header = { PATH_TABLE_MAGIC, PATH_TABLE_VERSION, table->n_vertices, table->checksum };
+    size_t n_pairs = table->n_vertices * table->n_vertices;
+    bool r = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        (fwrite(table->distances, sizeof(float), n_pairs, file) == n_pairs) &&
+        (fwrite(table->next, sizeof(uint32_t), n_pairs, file) == n_pairs);
+    if(fclose(file) != 0) {
+        r = false;
+    }
+    return r;
+}
+
+PathTable* path_table_load(CtsAllocator* alloc, const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL) {
+        return NULL;
+    }
+    PathTable* table = NULL;
+    PathTableHeader header;
+    bool r = (fread(&header, sizeof(header), 1, file) == 1) &&
+        (header.magic == PATH_TABLE_MAGIC) && (header.version == PATH_TABLE_VERSION) &&
+        (header.n_vertices < PATH_TABLE_NO_VERTEX);
+    if(r) {
+        table = path_table_new(alloc);
+        r = (table != NULL) && path_table_resize(table, (size_t)header.n_vertices);
+    }
+    if(r) {
+        size_t n = table->n_vertices;
+        size_t n_pairs = n * n;
+        table->checksum = header.checksum;
+        r = (fread(table->distances, sizeof(float), n_pairs, file) == n_pairs) &&
+            (fread(table->next, sizeof(uint32_t), n_pairs, file) == n_pairs);
+        // a damaged file must not send queries past the end of the table
+        for(size_t i = 0; (i < n_pairs) && r; i++) {
+            r = (table->next[i] < n) || (table->next[i] == PATH_TABLE_NO_VERTEX);
+        }
+    }
+    fclose(file);
+    if(!r && table) {
+        path_table_unref(table);
+        table = NULL;
+    }
+    return table;
+}
+
+bool graph_set_path_table(Graph* graph, PathTable* table) {
+    if(table != NULL) {
+        if(!graph_freeze_obstacles(graph) || !path_table_matches(table, graph)) {
+            return false;
+        }
+        path_table_ref(table);
+    }
+    if(graph->path_table) {
+        path_table_unref(graph->path_table);
+    }
+    graph->path_table = table;
+    return true;
+}
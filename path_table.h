@@ -0,0 +1,46 @@
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+#include <stdint.h>
+#include <Cts/cts.h>
+#include "visibility_graph.h"
+
+/*
+ * All pairs shortest paths between the obstacle vertices of a graph.
+ *
+ * path_table_build() runs Dijkstra from every obstacle vertex over the frozen obstacle graph, on
+ * graph->n_threads threads. distances[i * n + j] is the length of the shortest path from i to j and
+ * next[i * n + j] the vertex that follows i on it, so a path is read off by following next until j.
+ * Distances are stored as float to keep the table at 8 bytes per pair, which is also what it takes on
+ * disk.
+ *
+ * Attached to a graph with graph_set_path_table(), graph_query_path_between() and the batch queries
+ * only connect start and goal to the vertices they can see and pick the cheapest pair from the table,
+ * no search runs per query. Because of the float distances a pair within float rounding of the best
+ * one may win.
+ *
+ * path_table_save() writes the table in native byte order along with a checksum of the vertex
+ * coordinates. path_table_matches() tells whether a loaded table was built for a graph's obstacles,
+ * graph_set_path_table() refuses one that wasn't.
+ */
+
+#define PATH_TABLE_NO_VERTEX UINT32_MAX
+
+CTS_BEGIN_DECLARE_TYPE(CtsBase, PathTable, path_table)
+size_t n_vertices;
+uint64_t checksum; // of the obstacle vertex coordinates the table was built for
+float* distances; // n_vertices * n_vertices, INFINITY when unreachable
+uint32_t* next; // n_vertices * n_vertices, PATH_TABLE_NO_VERTEX when unreachable
+CTS_END_DECLARE_TYPE(PathTable, path_table)
+
+// new table built for graph, NULL if that fails
+PathTable* path_table_new_from_graph(CtsAllocator* alloc, Graph* graph);
+bool path_table_build(PathTable* table, Graph* graph);
+bool path_table_matches(PathTable* table, Graph* graph);
+bool path_table_save(PathTable* table, const char* filename);
+PathTable* path_table_load(CtsAllocator* alloc, const char* filename);
+
+// attaches a table built for graph's obstacles, NULL detaches. the graph keeps a reference
+bool graph_set_path_table(Graph* graph, PathTable* table);
+
+#endif
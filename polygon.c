@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <math.h>
 #include "polygon.h"
 
 CTS_DEFINE_TYPE(CtsBase, cts_base, Point, point)
@@ -19,8 +20,32 @@ Point* point_new_with_coords(CtsAllocator* alloc, double x, double y) {
 
 CTS_DEFINE_TYPE(CtsBase, cts_base, Polygon, polygon)
 
+static void polygon_reset_bounds(Polygon* polygon) {
+    polygon->min_x = INFINITY;
+    polygon->min_y = INFINITY;
+    polygon->max_x = -INFINITY;
+    polygon->max_y = -INFINITY;
+}
+
+static void polygon_extend_bounds(Polygon* polygon, double x, double y) {
+    if(!isfinite(x) || !isfinite(y)) {
+        // nothing can be ruled out for a polygon with a point at infinity
+        polygon->min_x = polygon->min_y = -INFINITY;
+        polygon->max_x = polygon->max_y = INFINITY;
+        return;
+    }
+    if(x < polygon->min_x) polygon->min_x = x;
+    if(y < polygon->min_y) polygon->min_y = y;
+    if(x > polygon->max_x) polygon->max_x = x;
+    if(y > polygon->max_y) polygon->max_y = y;
+}
+
 bool polygon_construct(Polygon* polygon) {
     CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) polygon);
+    polygon_reset_bounds(polygon);
+    polygon->compact_points = NULL;
+    polygon->n_points = 0;
+    polygon->capacity = 0;
     polygon->points = cts_array_new(alloc);
     if(polygon->points == NULL) {
         return false;
@@ -29,104 +54,321 @@ bool polygon_construct(Polygon* polygon) {
 }
 
 void polygon_destruct(Polygon* polygon) {
-    cts_array_free_full(polygon->points, NULL, (ArrayFreeFunc)cts_object_free);
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) polygon);
+    if(polygon->points) {
+        cts_array_free_full(polygon->points, NULL, (ArrayFreeFunc)cts_object_free);
+        cts_array_unref(polygon->points);
+    }
+    if(polygon->compact_points) {
+        cts_allocator_free(alloc, polygon->compact_points);
+    }
+}
+
+Polygon* polygon_new_compact(CtsAllocator* alloc) {
+    Polygon* polygon = polygon_new(alloc);
+    if(polygon == NULL) {
+        return NULL;
+    }
     cts_array_unref(polygon->points);
+    polygon->points = NULL;
+    return polygon;
+}
+
+// grows the block of a compact polygon. the points in it are plain copies, they hold no references
+static bool polygon_reserve(Polygon* polygon, size_t capacity) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) polygon);
+    if(capacity <= polygon->capacity) {
+        return true;
+    }
+    Point* points = (Point*)cts_allocator_realloc(alloc, polygon->compact_points, capacity * sizeof(Point));
+    if(points == NULL) {
+        return false;
+    }
+    polygon->compact_points = points;
+    polygon->capacity = capacity;
+    return true;
+}
+
+static inline Point* vertex(Polygon* polygon, size_t i) {
+    return polygon->points ? (Point*)cts_array_get(polygon->points, i) : &polygon->compact_points[i];
+}
+
+static inline double vertex_x(Polygon* polygon, size_t i) {
+    return vertex(polygon, i)->x;
+}
+
+static inline double vertex_y(Polygon* polygon, size_t i) {
+    return vertex(polygon, i)->y;
 }
 
 bool polygon_add_point(Polygon* polygon, double x, double y) {
     CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) polygon);
-    Point* p = point_new(alloc);
-    p->x = x;
-    p->y = y;
-    cts_array_append(polygon->points, p);
+    size_t i = polygon->n_points;
+    if(polygon->points) {
+        Point* p = point_new_with_coords(alloc, x, y);
+        if(p == NULL) {
+            return false;
+        }
+        if(!cts_array_append(polygon->points, p)) {
+            point_unref(p);
+            return false;
+        }
+    } else {
+        if((i == polygon->capacity) && !polygon_reserve(polygon, (i == 0) ? 4 : i * 2)) {
+            return false;
+        }
+        Point* p = &polygon->compact_points[i];
+        ((CtsBase*)p)->allocator = alloc;
+        point_class_init(p);
+        p->x = x;
+        p->y = y;
+    }
+    polygon->n_points++;
+    // the stored values, which float builds round
+    polygon_extend_bounds(polygon, vertex_x(polygon, i), vertex_y(polygon, i));
     return true;
 }
 
+void polygon_update_bounds(Polygon* polygon) {
+    polygon_reset_bounds(polygon);
+    for(size_t i = 0; i < polygon->n_points; i++) {
+        polygon_extend_bounds(polygon, vertex_x(polygon, i), vertex_y(polygon, i));
+    }
+}
+
+int polygon_winding(Polygon* polygon) {
+    size_t n = polygon->n_points;
+    double twice_area = 0;
+    for(size_t i = 0; i < n; i++) {
+        size_t k = (i + 1 == n) ? 0 : i + 1;
+        twice_area += vertex_x(polygon, i) * vertex_y(polygon, k) - vertex_x(polygon, k) * vertex_y(polygon, i);
+    }
+    return (twice_area > 0) - (twice_area < 0);
+}
+
+bool polygon_bounds_overlap(Polygon* polygon, double min_x, double min_y, double max_x, double max_y) {
+    return (min_x <= polygon->max_x) && (max_x >= polygon->min_x) &&
+        (min_y <= polygon->max_y) && (max_y >= polygon->min_y);
+}
+
 size_t polygon_size(Polygon* polygon) {
-    return cts_array_get_length(polygon->points);
+    return polygon->n_points;
 }
 
 Point* polygon_get_point(Polygon* polygon, int index) {
-    Point* p = (Point*)cts_array_get(polygon->points, index);
-    return p;
+    if((index < 0) || ((size_t)index >= polygon->n_points)) {
+        return NULL;
+    }
+    return vertex(polygon, index);
 }
 
-static size_t left_most_point(Polygon* polygon) {
+typedef struct HullPoint {
+    double x;
     double y;
-    size_t n_points = cts_array_get_length(polygon->points);
+    Point* point; // NULL in compact polygons
+    bool kept;
+} HullPoint;
 
-    if(n_points <= 1) {
-        return 0;
+static int compare_hull_points(const void* a, const void* b) {
+    const HullPoint* p = (const HullPoint*)a;
+    const HullPoint* q = (const HullPoint*)b;
+    if(p->x != q->x) {
+        return (p->x < q->x) ? -1 : 1;
     }
-
-    Point* p = (Point*)cts_array_get(polygon->points, 0);
-    y = p->y;
-    size_t r = 0;
-
-    for(size_t i = 1; i < n_points; i++) {
-        p = (Point*)cts_array_get(polygon->points, i);
-        if(p->y <= y) {
-            y = p->y;
-            r = i;
-        } 
+    if(p->y != q->y) {
+        return (p->y < q->y) ? -1 : 1;
     }
-    return r;
+    return 0;
 }
 
-static int orientation(Point* p, Point* q, Point* r) {
-    double val = (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
-
-    if (val == 0) return 0;  // collinear
-    return (val > 0) ? 1 : 2; // clock or counterclock wise
+// > 0 if o, a, b turn counterclockwise
+static double cross(const HullPoint* o, const HullPoint* a, const HullPoint* b) {
+    return (a->x - o->x) * (b->y - o->y) - (a->y - o->y) * (b->x - o->x);
 }
 
+// Andrew's monotone chain. the coordinates are copied into one buffer and sorted by x,
+// the lower and upper chains are built on top of it and the hull is written back over the start of the
+// polygon, so no points are created and only the ones left out are released. the hull runs
+// counterclockwise without collinear points
 void polygon_giftwrap(Polygon* polygon) {
     CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) polygon);
-    size_t numPoints = cts_array_get_length(polygon->points);
+    size_t numPoints = polygon->n_points;
     if(numPoints < 3) return; // Convex hull is not possible for less than 3 points
 
-    // get the left most point
-    size_t lmp = left_most_point(polygon);
+    // the polygon is left as it was if memory runs out
+    HullPoint* sorted = (HullPoint*)cts_allocator_alloc(alloc, numPoints * sizeof(HullPoint));
+    if(sorted == NULL) {
+        return;
+    }
+    HullPoint** hull = (HullPoint**)cts_allocator_alloc(alloc, (numPoints + 1) * sizeof(HullPoint*));
+    if(hull == NULL) {
+        cts_allocator_free(alloc, sorted);
+        return;
+    }
 
-    // gift wrapping algorithm
-    // Create an array to store points of convex hull
-    size_t* hull = (size_t*)cts_allocator_alloc(alloc, numPoints * sizeof(size_t));
-    size_t m = 0;  // Initialize result (number of points in hull)
+    for(size_t i = 0; i < numPoints; i++) {
+        sorted[i].x = vertex_x(polygon, i);
+        sorted[i].y = vertex_y(polygon, i);
+        sorted[i].point = polygon->points ? (Point*)cts_array_get(polygon->points, i) : NULL;
+        sorted[i].kept = false;
+    }
 
-    size_t p = lmp, q;
-    do {
-        // add current point to result
-        hull[m] = p;
-        m++;
+    // points strictly inside the quadrilateral of the lowest, rightmost, highest and leftmost points
+    // can't be on the hull. dropping them first leaves little to sort in clouds of scattered points
+    HullPoint corners[4] = { sorted[0], sorted[0], sorted[0], sorted[0] };
+    for(size_t i = 1; i < numPoints; i++) {
+        if(sorted[i].y < corners[0].y) corners[0] = sorted[i];
+        if(sorted[i].x > corners[1].x) corners[1] = sorted[i];
+        if(sorted[i].y > corners[2].y) corners[2] = sorted[i];
+        if(sorted[i].x < corners[3].x) corners[3] = sorted[i];
+    }
+    size_t n = 0;
+    for(size_t i = 0; i < numPoints; i++) {
+        bool inside = true;
+        for(int k = 0; (k < 4) && inside; k++) {
+            inside = cross(&corners[k], &corners[(k + 1) % 4], &sorted[i]) > 0;
+        }
+        if(!inside) {
+            sorted[n++] = sorted[i];
+        } else if(sorted[i].point) {
+            point_unref(sorted[i].point);
+        }
+    }
+    qsort(sorted, n, sizeof(HullPoint), compare_hull_points);
 
-        // Search for a point 'q' such that orientation(p, x, q) is counterclockwise for all points 'x'
-        q = (p + 1) % numPoints;
-        for (size_t i = 0; i < numPoints; i++) {
-            // If i is more counterclockwise than current q, then update q
-            if (orientation((Point*)cts_array_get(polygon->points, p), (Point*)cts_array_get(polygon->points, i), (Point*)cts_array_get(polygon->points, q)) == 2)
-                q = i;
+    size_t m = 0;
+    for(size_t i = 0; i < n; i++) {
+        while((m >= 2) && (cross(hull[m - 2], hull[m - 1], &sorted[i]) <= 0)) {
+            m--;
+        }
+        hull[m++] = &sorted[i];
+    }
+    size_t lower = m + 1;
+    for(size_t i = n - 1; i-- > 0;) {
+        while((m >= lower) && (cross(hull[m - 2], hull[m - 1], &sorted[i]) <= 0)) {
+            m--;
         }
+        hull[m++] = &sorted[i];
+    }
+    m--; // the last point is the first one again
 
-        // Now q is the most counterclockwise with respect to p
-        // Set p as q for next iteration, so that q is added to result 'hull'
-        p = q;
+    if(polygon->points) {
+        // points left out of the hull are released before their slots are reused
+        for(size_t i = 0; i < m; i++) {
+            hull[i]->kept = true;
+        }
+        for(size_t i = 0; i < n; i++) {
+            if(!sorted[i].kept) {
+                point_unref(sorted[i].point);
+            }
+        }
+        for(size_t i = 0; i < m; i++) {
+            cts_array_replace(polygon->points, i, hull[i]->point);
+        }
+        for(size_t i = numPoints; i > m; i--) {
+            cts_array_remove_index(polygon->points, i - 1);
+        }
+    }
 
-    } while (p != lmp);  // While we don't come to first point
+    polygon_reset_bounds(polygon);
+    for(size_t i = 0; i < m; i++) {
+        if(polygon->compact_points) {
+            polygon->compact_points[i].x = hull[i]->x;
+            polygon->compact_points[i].y = hull[i]->y;
+        }
+        polygon_extend_bounds(polygon, hull[i]->x, hull[i]->y);
+    }
+    polygon->n_points = m;
 
-    CtsArray* arr = cts_array_new(alloc);
-    // Print Result
-    for (size_t i = 0; i < m; i++) {
-        Point* point = (Point*)cts_array_get(polygon->points, hull[i]);
-        point_ref(point);
-        cts_array_append(arr, point);
+    cts_allocator_free(alloc, hull);
+    cts_allocator_free(alloc, sorted);
+}
+
+Polygon* polygon_new_inflated(CtsAllocator* alloc, Polygon* polygon, double radius, PolygonInflateShape shape, size_t n_segments) {
+    Polygon* inflated = polygon_new_compact(alloc);
+    if(inflated == NULL) {
+        return NULL;
     }
 
-    cts_array_free_full(polygon->points, NULL, (ArrayFreeFunc)cts_object_free);
-    cts_array_unref(polygon->points);
-    polygon->points = arr;
+    // corners of the shape the polygon is swept with
+    size_t n_corners = 4;
+    double corner_radius = radius * sqrt(2);
+    double first_angle = M_PI / 4;
+    if(shape == POLYGON_INFLATE_DISC) {
+        n_corners = (n_segments < 3) ? 3 : n_segments;
+        // circumscribed, so the edges stay outside the circle
+        corner_radius = radius / cos(M_PI / n_corners);
+        first_angle = 0;
+    }
 
-    // Free the allocated memory
-    cts_allocator_free(alloc, hull);
+    bool r = true;
+    size_t n_points = polygon_size(polygon);
+    for(size_t i = 0; (i < n_points) && r; i++) {
+        for(size_t k = 0; (k < n_corners) && r; k++) {
+            double angle = first_angle + 2 * M_PI * k / n_corners;
+            r = polygon_add_point(inflated, vertex_x(polygon, i) + corner_radius * cos(angle), vertex_y(polygon, i) + corner_radius * sin(angle));
+        }
+    }
+    if(!r) {
+        polygon_unref(inflated);
+        return NULL;
+    }
+    // the sum of two convex shapes is the hull of all corner sums
+    polygon_giftwrap(inflated);
+    return inflated;
+}
+
+Polygon* polygon_new_merged(CtsAllocator* alloc, Polygon* a, Polygon* b) {
+    Polygon* merged = polygon_new_compact(alloc);
+    if(merged == NULL) {
+        return NULL;
+    }
+    bool r = true;
+    for(size_t i = 0; (i < a->n_points) && r; i++) {
+        r = polygon_add_point(merged, vertex_x(a, i), vertex_y(a, i));
+    }
+    for(size_t i = 0; (i < b->n_points) && r; i++) {
+        r = polygon_add_point(merged, vertex_x(b, i), vertex_y(b, i));
+    }
+    if(!r) {
+        polygon_unref(merged);
+        return NULL;
+    }
+    polygon_giftwrap(merged);
+    return merged;
 }
 
+// projects every point onto the normal of each edge of a and looks for a gap
+static bool separated_by_edge_of(Polygon* a, Polygon* b) {
+    size_t n_a = a->n_points;
+    for(size_t i = 0; i < n_a; i++) {
+        size_t k = (i + 1 == n_a) ? 0 : i + 1;
+        double nx = vertex_y(a, k) - vertex_y(a, i);
+        double ny = vertex_x(a, i) - vertex_x(a, k);
 
+        double min_a = INFINITY, max_a = -INFINITY;
+        for(size_t j = 0; j < n_a; j++) {
+            double d = nx * vertex_x(a, j) + ny * vertex_y(a, j);
+            min_a = fmin(min_a, d);
+            max_a = fmax(max_a, d);
+        }
+        double min_b = INFINITY, max_b = -INFINITY;
+        for(size_t j = 0; j < b->n_points; j++) {
+            double d = nx * vertex_x(b, j) + ny * vertex_y(b, j);
+            min_b = fmin(min_b, d);
+            max_b = fmax(max_b, d);
+        }
+        if((max_a < min_b) || (max_b < min_a)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool polygon_convex_overlap(Polygon* a, Polygon* b) {
+    if((polygon_size(a) == 0) || (polygon_size(b) == 0) ||
+        !polygon_bounds_overlap(a, b->min_x, b->min_y, b->max_x, b->max_y)) {
+        return false;
+    }
+    return !separated_by_edge_of(a, b) && !separated_by_edge_of(b, a);
+}
@@ -3,21 +3,60 @@
 
 #include <Cts/cts.h>
 
+// stored coordinates are double unless built with POLYGON_FLOAT_COORDINATES, which halves them for
+// targets short on memory. arithmetic on them is done in double either way, which isn't exact: like
+// double builds, float builds can get the sign of an orientation test wrong for nearly collinear
+// points. on the regression scenes a float build finds the same paths as a double build
+#ifdef POLYGON_FLOAT_COORDINATES
+typedef float Coord;
+#else
+typedef double Coord;
+#endif
+
 CTS_BEGIN_DECLARE_TYPE(CtsBase, Point, point)
-double x;
-double y;
+Coord x;
+Coord y;
 CTS_END_DECLARE_TYPE(Point, point)
 
 Point* point_new_with_coords(CtsAllocator* alloc, double x, double y);
 
 CTS_BEGIN_DECLARE_TYPE(CtsBase, Polygon, polygon) 
-CtsArray* points;
+CtsArray* points; // a Point* per vertex, NULL in compact polygons
+Point* compact_points; // compact polygons only: the points themselves, in one block
+size_t n_points;
+size_t capacity; // of compact_points
+double min_x; // bounding box, kept up to date by polygon_add_point. empty polygons have min > max
+double min_y;
+double max_x;
+double max_y;
 CTS_END_DECLARE_TYPE(Polygon, polygon)
 
+typedef enum PolygonInflateShape {
+    POLYGON_INFLATE_DISC, // regular polygon with n_segments sides around a circle of the radius
+    POLYGON_INFLATE_SQUARE // axis aligned square with half side radius
+} PolygonInflateShape;
+
+// a polygon without an allocation per point. the points polygon_get_point returns live in a block owned
+// by the polygon: they can't be ref'd past the polygon's lifetime and move when points are added or the
+// hull is taken, so get them again after changing the polygon
+Polygon* polygon_new_compact(CtsAllocator* alloc);
 bool polygon_add_point(Polygon* polygon, double x, double y);
+// recomputes the bounding box, for points of an ordinary polygon that were moved in place
+void polygon_update_bounds(Polygon* polygon);
 size_t polygon_size(Polygon* polygon);
 Point* polygon_get_point(Polygon* polygon, int index);
+// replaces the points with their convex hull, counterclockwise and without collinear points
 void polygon_giftwrap(Polygon* polygon);
+// 1 if the points run counterclockwise, -1 if clockwise, 0 if they enclose no area
+int polygon_winding(Polygon* polygon);
+bool polygon_bounds_overlap(Polygon* polygon, double min_x, double min_y, double max_x, double max_y);
+// Minkowski sum of the polygon's convex hull and the shape, so a robot of that size centred anywhere
+// outside the result clears the polygon. new polygon, NULL if memory ran out
+Polygon* polygon_new_inflated(CtsAllocator* alloc, Polygon* polygon, double radius, PolygonInflateShape shape, size_t n_segments);
+// convex hull of both polygons
+Polygon* polygon_new_merged(CtsAllocator* alloc, Polygon* a, Polygon* b);
+// separating axis test, touching counts as overlapping. both polygons must be convex
+bool polygon_convex_overlap(Polygon* a, Polygon* b);
 
 #endif 
 
@@ -0,0 +1,71 @@
+#ifndef SEGMENT_BATCH_H
+#define SEGMENT_BATCH_H
+
+#include <Cts/cts.h>
+#include "polygon.h"
+
+/*
+ * Obstacle edges packed as structure of arrays for testing one sight line against many edges at once.
+ *
+ * segment_batch_intersects_any() gives exactly the same answer as calling intersects() on every edge
+ * that doesn't share an endpoint (by pointer) with the sight line, which is what is_visible() does.
+ * The vector kernels evaluate the same double precision expressions in the same order as the scalar
+ * predicate, so there's no tolerance involved. Coordinates are copied when an edge is added, moving a
+ * point afterwards requires rebuilding the batch.
+ *
+ * Edges added with segment_batch_add_polygon() are grouped with the polygon's bounding box and
+ * segment_batch_intersects_any() skips a whole group when its box doesn't overlap the box of the
+ * sight line. Like the grid, that only changes the answer where orientation() rounding reports a
+ * crossing for disjoint, nearly collinear segments.
+ *
+ * On x86 the AVX2 kernel (4 edges per instruction) is picked at runtime when the CPU supports it,
+ * otherwise SSE2 (2 edges). Other targets, builds with SEGMENT_BATCH_NO_SIMD and builds without
+ * optimisation use the scalar loop, the vector kernels only pay off when compiled with -O1 or more.
+ */
+
+// edges begin .. end - 1 came from one polygon with this bounding box
+typedef struct SegmentGroup {
+    size_t begin;
+    size_t end;
+    double min_x;
+    double min_y;
+    double max_x;
+    double max_y;
+} SegmentGroup;
+
+typedef enum SegmentBatchKernel {
+    SEGMENT_BATCH_SCALAR,
+    SEGMENT_BATCH_SSE2,
+    SEGMENT_BATCH_AVX2
+} SegmentBatchKernel;
+
+CTS_BEGIN_DECLARE_TYPE(CtsBase, SegmentBatch, segment_batch)
+double* x1; // edge start
+double* y1;
+double* x2; // edge end
+double* y2;
+Point** from;
+Point** to;
+size_t length;
+size_t capacity;
+SegmentGroup* groups;
+size_t n_groups;
+size_t groups_capacity;
+size_t n_groups_skipped; // groups whose box missed the sight line, updated atomically
+SegmentBatchKernel kernel;
+CTS_END_DECLARE_TYPE(SegmentBatch, segment_batch)
+
+bool segment_batch_reserve(SegmentBatch* batch, size_t capacity);
+bool segment_batch_add(SegmentBatch* batch, Point* from, Point* to);
+bool segment_batch_add_polygon(SegmentBatch* batch, Polygon* polygon);
+void segment_batch_clear(SegmentBatch* batch);
+bool segment_batch_intersects_any(SegmentBatch* batch, Point* from, Point* to);
+// same as segment_batch_intersects_any() for edges begin .. end - 1 only
+bool segment_batch_intersects_range(SegmentBatch* batch, size_t begin, size_t end, Point* from, Point* to);
+
+// the best kernel this CPU supports. new batches use it when the build is optimised
+SegmentBatchKernel segment_batch_detect_kernel();
+// forces a kernel, e.g. to compare against the scalar one. must be supported by the CPU
+void segment_batch_set_kernel(SegmentBatch* batch, SegmentBatchKernel kernel);
+
+#endif
@@ -1,6 +1,13 @@
 #include <stdio.h>
 #include <math.h>
 #include "visibility_graph.h"
+#include "visibility_sweep.h"
+#include "visibility_parallel.h"
+#include "segment_batch.h"
+#include "obstacle_grid.h"
+#include "csr_graph.h"
+#include "path_search.h"
+#include "path_table.h"
 #include "polygon.h"
 
 // A small number for floating-point comparison
@@ -33,6 +40,10 @@ bool adjacency_node_construct(AdjacencyNode* self) {
     CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) self);
     self->root = NULL;
     self->polygon = NULL;
+    self->side_prev = NULL;
+    self->side_next = NULL;
+    self->reflex = false;
+    self->n_static = 0;
     self->adjacent_points = cts_slist_new(alloc);
     return true;
 }
@@ -65,33 +76,73 @@ int compare_graph_nodes(const GraphNode* a, const GraphNode* b) {
     return 0;
 }
 
-double heuristic(Point* point1, Point* point2) {
-    double dx = point1->x - point2->x;
-    double dy = point1->y - point2->y;
-    return sqrt(dx*dx + dy*dy);
-}
-
 CTS_DEFINE_TYPE(CtsBase, cts_base, Graph, graph)
 
 bool graph_construct(Graph* graph) {
     CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) graph);
     graph->polygons = cts_array_new(alloc);
+    graph->inflated = cts_array_new(alloc);
+    graph->inflate_radius = 0;
+    graph->inflate_shape = POLYGON_INFLATE_DISC;
+    graph->inflate_segments = 8;
     graph->start_point = NULL;
     graph->end_point = NULL;
-    if(graph->polygons == NULL) {
+    if((graph->polygons == NULL) || (graph->inflated == NULL)) {
         return false;
     }
 
     graph->adjacency = cts_array_new(alloc);
+    graph->obstacle_edges = segment_batch_new(alloc);
+    graph->obstacle_edges_valid = false;
+    graph->obstacle_grid = NULL;
+    graph->use_spatial_index = true;
+    graph->n_polygons_skipped = 0;
+    graph->csr = NULL;
+    graph->obstacle_csr = NULL;
+    graph->obstacle_csr_valid = false;
+    graph->path_table = NULL;
+    graph->search = NULL;
+    graph->path_queue = PATH_SEARCH_LAZY_HEAP;
+    graph->bidirectional_search = false;
+    graph->n_expanded = 0;
+    graph->freeze_adjacency = false;
+    graph->csr_valid = false;
+    if(graph->obstacle_edges == NULL) {
+        return false;
+    }
+    graph->visibility_mode = GRAPH_VISIBILITY_BRUTE_FORCE;
+    graph->reduced = false;
+    graph->n_obstacle_vertices = 0;
+    graph->obstacles_dirty = true;
+    graph->n_threads = 1;
     return true;
 }
 
 void graph_destruct(Graph* graph) {
+    segment_batch_unref(graph->obstacle_edges);
+    if(graph->obstacle_grid) {
+        obstacle_grid_unref(graph->obstacle_grid);
+    }
+    if(graph->csr) {
+        csr_graph_unref(graph->csr);
+    }
+    if(graph->obstacle_csr) {
+        csr_graph_unref(graph->obstacle_csr);
+    }
+    if(graph->path_table) {
+        path_table_unref(graph->path_table);
+    }
+    if(graph->search) {
+        path_search_unref(graph->search);
+    }
+
     cts_array_free_full(graph->adjacency, NULL, (ArrayFreeFunc)cts_object_free);
     cts_array_unref(graph->adjacency);
 
     cts_array_free_full(graph->polygons, NULL, (ArrayFreeFunc)cts_object_free);
     cts_array_unref(graph->polygons);
+    cts_array_free_full(graph->inflated, NULL, (ArrayFreeFunc)cts_object_free);
+    cts_array_unref(graph->inflated);
 
     if(graph->start_point) {
         point_unref(graph->start_point);
@@ -113,10 +164,12 @@ static double min(double a, double b) {
 void graph_add_polygon(Graph* graph, Polygon* polygon) {
     cts_array_append(graph->polygons, polygon);
     polygon_ref(polygon);
+    graph->obstacles_dirty = true;
+    graph->obstacle_edges_valid = false;
 }
 
 double orientation(Point* p, Point* q, Point* r) {
-    double val = (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+    double val = ((double)q->y - p->y) * ((double)r->x - q->x) - ((double)q->x - p->x) * ((double)r->y - q->y);
     if (val == 0) return 0;  // collinear
     return (val > 0) ? 1: 2; // clock or counterclock
 }
@@ -157,12 +210,36 @@ bool intersects(Edge* e1, Edge* e2) {
 }
 
 
-static bool is_visible(Graph* graph, AdjacencyNode* n1, AdjacencyNode* n2) {
-    Edge edge = { n1->root, n2->root }; 
+bool is_visible(Graph* graph, AdjacencyNode* n1, AdjacencyNode* n2) {
+    return graph_points_visible(graph, n1->root, n2->root);
+}
+
+bool graph_points_visible(Graph* graph, Point* from, Point* to) {
+    if(graph->obstacle_edges_valid) {
+        if(graph->obstacle_grid) {
+            return !obstacle_grid_intersects_any(graph->obstacle_grid, from, to);
+        }
+        return !segment_batch_intersects_any(graph->obstacle_edges, from, to);
+    }
+
+    Edge edge = { from, to };
 
-    size_t n_polygons = cts_array_get_length(graph->polygons);
+    bool finite = isfinite(edge.from->x) && isfinite(edge.from->y) && isfinite(edge.to->x) && isfinite(edge.to->y);
+    double min_x = min(edge.from->x, edge.to->x);
+    double min_y = min(edge.from->y, edge.to->y);
+    double max_x = max(edge.from->x, edge.to->x);
+    double max_y = max(edge.from->y, edge.to->y);
+
+    CtsArray* obstacles = graph_get_obstacles(graph);
+    size_t n_polygons = cts_array_get_length(obstacles);
     for(size_t i = 0; i < n_polygons; i++) {
-        Polygon* polygon = (Polygon*)cts_array_get(graph->polygons, i);
+        Polygon* polygon = (Polygon*)cts_array_get(obstacles, i);
+
+        // none of the edges can be crossed if the boxes don't overlap
+        if(finite && !polygon_bounds_overlap(polygon, min_x, min_y, max_x, max_y)) {
+            __atomic_fetch_add(&graph->n_polygons_skipped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
 
         // iterate over each edge in the polygon
         for(size_t j = 0; j < polygon_size(polygon); j++) {
@@ -187,23 +264,293 @@ static bool is_visible(Graph* graph, AdjacencyNode* n1, AdjacencyNode* n2) {
     return true;
 }
 
+// which side of the line from a through b the point is on, 0 if it's on the line
+static int side_of(Point* a, Point* b, Point* point) {
+    double c = ((double)b->x - a->x) * ((double)point->y - a->y) - ((double)b->y - a->y) * ((double)point->x - a->x);
+    return (c > 0) - (c < 0);
+}
+
+static bool vertex_is_reflex(Polygon* polygon, int winding, size_t j) {
+    size_t n = polygon_size(polygon);
+    Point* prev = polygon_get_point(polygon, (j + n - 1) % n);
+    Point* next = polygon_get_point(polygon, (j + 1) % n);
+    return side_of(prev, polygon_get_point(polygon, j), next) * winding < 0;
+}
+
+bool graph_link_is_tangent(Graph* graph, AdjacencyNode* n, Point* point) {
+    if(!graph->reduced || (n->polygon == NULL)) {
+        return true;
+    }
+    if(n->reflex) {
+        return false;
+    }
+    // both neighbours on the same side: the line only touches the polygon at n
+    return side_of(n->root, point, n->side_prev) * side_of(n->root, point, n->side_next) >= 0;
+}
+
+static bool bitangent(Graph* graph, AdjacencyNode* n, AdjacencyNode* n2) {
+    return graph_link_is_tangent(graph, n, n2->root) && graph_link_is_tangent(graph, n2, n->root);
+}
+
 void free_adjacency_node(CtsAllocator* alloc, AdjacencyNode* n) {
     (void)alloc;
     adjacency_node_unref(n);
 }
 
-bool graph_calculate_visibility(Graph* graph) {
+static void brute_force_row(Graph* graph, size_t i, bool* row) {
+    // start and end get their links in calculate_endpoint_visibility
+    size_t numVertices = graph->n_obstacle_vertices;
+    AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+    for(size_t j = 0; j < numVertices; j++) {
+        AdjacencyNode* n2 = (AdjacencyNode*)cts_array_get(graph->adjacency, j);
+        row[j] = false;
+        if(n == n2) {
+            continue;
+        }
+
+        if((n->polygon != NULL) && (n->polygon == n2->polygon)) {
+            continue;
+        }
+
+        row[j] = bitangent(graph, n, n2) && is_visible(graph, n, n2);
+    }
+}
+
+// true if the line from n towards point starts off into the inside of n's polygon
+static bool link_enters_polygon(AdjacencyNode* n, int winding, Point* point) {
+    bool inside_prev = side_of(n->side_prev, n->root, point) * winding > 0;
+    bool inside_next = side_of(n->root, n->side_next, point) * winding > 0;
+    return n->reflex ? (inside_prev || inside_next) : (inside_prev && inside_next);
+}
+
+// links across the pockets of a concave polygon, between vertices of the same polygon that see
+// each other around the outside
+static void pocket_row(Graph* graph, size_t i, bool* row) {
+    AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+    if(n->polygon == NULL) {
+        return;
+    }
+    int winding = polygon_winding(n->polygon);
+    for(size_t j = 0; j < graph->n_obstacle_vertices; j++) {
+        AdjacencyNode* n2 = (AdjacencyNode*)cts_array_get(graph->adjacency, j);
+        if((n2 == n) || (n2->polygon != n->polygon) || (n2->root == n->side_prev) || (n2->root == n->side_next)) {
+            continue;
+        }
+        row[j] = !link_enters_polygon(n, winding, n2->root) && !link_enters_polygon(n2, winding, n->root) &&
+            bitangent(graph, n, n2) && is_visible(graph, n, n2);
+    }
+}
+
+// drops links of a visibility row that aren't bitangents
+static void reduce_row(Graph* graph, size_t i, bool* row) {
+    AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+    for(size_t j = 0; j < graph->n_obstacle_vertices; j++) {
+        if(row[j]) {
+            row[j] = bitangent(graph, n, (AdjacencyNode*)cts_array_get(graph->adjacency, j));
+        }
+    }
+}
+
+void graph_visibility_row(Graph* graph, VisibilitySweep* sweep, size_t i, bool* row) {
+    AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+    if(graph->reduced && n->reflex) {
+        for(size_t j = 0; j < graph->n_obstacle_vertices; j++) {
+            row[j] = false;
+        }
+        return;
+    }
+
+    // rows the sweep can't decide fall back to testing every pair
+    if((sweep == NULL) || !visibility_sweep_row(sweep, i, row)) {
+        brute_force_row(graph, i, row);
+    }
+    pocket_row(graph, i, row);
+    if(graph->reduced) {
+        reduce_row(graph, i, row);
+    }
+}
+
+static bool append_row(Graph* graph, size_t i, const bool* row) {
+    AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+    for(size_t j = 0; j < graph->n_obstacle_vertices; j++) {
+        if(row[j]) {
+            AdjacencyNode* n2 = (AdjacencyNode*)cts_array_get(graph->adjacency, j);
+            if(!cts_slist_append(n->adjacent_points, n2->root)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool calculate_rows_parallel(Graph* graph, VisibilitySweep* sweep, size_t n_threads, bool* row) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)graph);
+    size_t n_rows = graph->n_obstacle_vertices;
+    size_t stride = (n_rows + 7) / 8;
+
+    uint8_t* bitmap = (uint8_t*)cts_allocator_alloc(alloc, stride * n_rows + 1);
+    if(bitmap == NULL) {
+        return false;
+    }
+    if(!visibility_parallel_rows(graph, sweep, n_threads, bitmap, stride)) {
+        cts_allocator_free(alloc, bitmap);
+        return false;
+    }
+
+    // the workers only fill the bitmap, the lists are appended here on the calling thread
+    bool r = true;
+    for(size_t i = 0; (i < n_rows) && r; i++) {
+        const uint8_t* bits = &bitmap[i * stride];
+        for(size_t j = 0; j < n_rows; j++) {
+            row[j] = (bits[j / 8] >> (j % 8)) & 1;
+        }
+        r = append_row(graph, i, row);
+    }
+    cts_allocator_free(alloc, bitmap);
+    return r;
+}
+
+static bool calculate_obstacle_rows(Graph* graph) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)graph);
+    size_t numVertices = cts_array_get_length(graph->adjacency);
+
+    VisibilitySweep* sweep = NULL;
+    if(graph->visibility_mode == GRAPH_VISIBILITY_SWEEP) {
+        sweep = visibility_sweep_new_from_graph(alloc, graph);
+        if(sweep == NULL) {
+            return false;
+        }
+        if(!visibility_sweep_is_usable(sweep)) {
+            visibility_sweep_unref(sweep);
+            sweep = NULL;
+        }
+    }
+
+    bool* row = (bool*)cts_allocator_alloc(alloc, sizeof(bool) * numVertices);
+    if(row == NULL) {
+        if(sweep) {
+            visibility_sweep_unref(sweep);
+        }
+        return false;
+    }
+
+    bool r = true;
+    size_t n_threads = visibility_parallel_thread_count(graph->n_threads);
+    // the parallel build needs scratch memory for every worker; without it the rows are done here
+    if((n_threads <= 1) || !calculate_rows_parallel(graph, sweep, n_threads, row)) {
+        for(size_t i = 0; (i < graph->n_obstacle_vertices) && r; i++) {
+            graph_visibility_row(graph, sweep, i, row);
+            r = append_row(graph, i, row);
+        }
+    }
+
+    cts_allocator_free(alloc, row);
+    if(sweep) {
+        visibility_sweep_unref(sweep);
+    }
+    return r;
+}
+
+// builds the visibility graph between obstacle vertices. start and end get empty stubs at the end of the adjacency array
+CtsArray* graph_get_obstacles(Graph* graph) {
+    return (graph->inflate_radius > 0) ? graph->inflated : graph->polygons;
+}
+
+// merges overlapping polygons of the inflated array until none overlap
+static bool merge_inflated(Graph* graph) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)graph);
+    CtsArray* inflated = graph->inflated;
+    bool changed = true;
+    while(changed) {
+        // a merged polygon is bigger and may now reach polygons checked against it before
+        changed = false;
+        for(size_t i = 0; i < cts_array_get_length(inflated); i++) {
+            size_t j = i + 1;
+            while(j < cts_array_get_length(inflated)) {
+                Polygon* a = (Polygon*)cts_array_get(inflated, i);
+                Polygon* b = (Polygon*)cts_array_get(inflated, j);
+                if(!polygon_convex_overlap(a, b)) {
+                    j++;
+                    continue;
+                }
+                Polygon* merged = polygon_new_merged(alloc, a, b);
+                if(merged == NULL) {
+                    return false;
+                }
+                polygon_unref((Polygon*)cts_array_replace(inflated, i, merged));
+                polygon_unref((Polygon*)cts_array_remove_index(inflated, j));
+                changed = true;
+                j = i + 1;
+            }
+        }
+    }
+    return true;
+}
+
+static bool inflate_obstacles(Graph* graph) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)graph);
+    cts_array_free_full(graph->inflated, NULL, (ArrayFreeFunc)cts_object_free);
+    if(graph->inflate_radius <= 0) {
+        return true;
+    }
+    for(size_t i = 0; i < cts_array_get_length(graph->polygons); i++) {
+        Polygon* polygon = (Polygon*)cts_array_get(graph->polygons, i);
+        if(polygon_size(polygon) == 0) {
+            continue;
+        }
+        Polygon* inflated = polygon_new_inflated(alloc, polygon, graph->inflate_radius, graph->inflate_shape, graph->inflate_segments);
+        if(inflated == NULL) {
+            return false;
+        }
+        if(!cts_array_append(graph->inflated, inflated)) {
+            polygon_unref(inflated);
+            return false;
+        }
+    }
+    return merge_inflated(graph);
+}
+
+static bool calculate_obstacle_visibility(Graph* graph) {
     // Clear existing vertices and edges
     cts_array_free_full(graph->adjacency, NULL, (ArrayFreeFunc)free_adjacency_node);
 
+    if(!inflate_obstacles(graph)) {
+        return false;
+    }
+    CtsArray* obstacles = graph_get_obstacles(graph);
+
+    segment_batch_clear(graph->obstacle_edges);
+    for(size_t i = 0; i < cts_array_get_length(obstacles); i++) {
+        // points may have been moved since the polygon was added
+        polygon_update_bounds((Polygon*)cts_array_get(obstacles, i));
+        if(!segment_batch_add_polygon(graph->obstacle_edges, (Polygon*)cts_array_get(obstacles, i))) {
+            return false;
+        }
+    }
+    graph->obstacle_edges_valid = true;
+
+    if(graph->obstacle_grid) {
+        obstacle_grid_unref(graph->obstacle_grid);
+        graph->obstacle_grid = NULL;
+    }
+    if(graph->use_spatial_index) {
+        // the grid only speeds things up, without memory for it every edge is tested instead
+        graph->obstacle_grid = obstacle_grid_new_from_batch(cts_base_get_allocator((CtsBase*)graph), graph->obstacle_edges);
+        if(graph->obstacle_grid && !obstacle_grid_is_usable(graph->obstacle_grid)) {
+            obstacle_grid_unref(graph->obstacle_grid);
+            graph->obstacle_grid = NULL;
+        }
+    }
+
     // create adjacency list stubs from polygons
-    for(size_t i = 0; i < cts_array_get_length(graph->polygons); i++) {
-        Polygon* polygon = (Polygon*)cts_array_get(graph->polygons, i);
-        for(size_t j = 0; j < cts_array_get_length(polygon->points); j++) {
-            Point* point = (Point*)cts_array_get(polygon->points, j);
+    for(size_t i = 0; i < cts_array_get_length(obstacles); i++) {
+        Polygon* polygon = (Polygon*)cts_array_get(obstacles, i);
+        int winding = polygon_winding(polygon);
+        size_t n_points = polygon_size(polygon);
+        for(size_t j = 0; j < n_points; j++) {
+            Point* point = polygon_get_point(polygon, j);
             //point_ref(point);
 
-            extern size_t n_allocs;
             AdjacencyNode* an = adjacency_node_new(cts_base_get_allocator((CtsBase*)graph));
             if(an == NULL) {
                 cts_array_free_full(graph->adjacency, NULL, (ArrayFreeFunc)free_adjacency_node);
@@ -213,17 +560,26 @@ bool graph_calculate_visibility(Graph* graph) {
             an->root = point;
             an->polygon = polygon;
 
-            Point* next_point = cts_array_get(polygon->points, (j+1) % cts_array_get_length(polygon->points));
-            //point_ref(next_point);
-            cts_slist_append(an->adjacent_points, next_point);
+            Point* next_point = polygon_get_point(polygon, (j + 1) % n_points);
+            Point* prev_point = polygon_get_point(polygon, (j - 1 + n_points) % n_points);
+            an->side_next = next_point;
+            an->side_prev = prev_point;
+            an->reflex = vertex_is_reflex(polygon, winding, j);
 
-            Point* prev_point = cts_array_get(polygon->points, (j - 1 + cts_array_get_length(polygon->points)) % cts_array_get_length(polygon->points));
-            //point_ref(prev_point);
-            cts_slist_append(an->adjacent_points, prev_point);
+            // a reduced graph has no sides ending at a reflex vertex
+            if(!graph->reduced || (!an->reflex && !vertex_is_reflex(polygon, winding, (j + 1) % n_points))) {
+                //point_ref(next_point);
+                cts_slist_append(an->adjacent_points, next_point);
+            }
+            if(!graph->reduced || (!an->reflex && !vertex_is_reflex(polygon, winding, (j - 1 + n_points) % n_points))) {
+                //point_ref(prev_point);
+                cts_slist_append(an->adjacent_points, prev_point);
+            }
 
             cts_array_append(graph->adjacency, an);
         }
     }
+    graph->n_obstacle_vertices = cts_array_get_length(graph->adjacency);
 
     // Add start and end points to adjacency list
     //point_ref(graph->start_point);
@@ -244,26 +600,168 @@ bool graph_calculate_visibility(Graph* graph) {
     an->root = graph->end_point;
     cts_array_append(graph->adjacency, an);
 
-    // Calculate edges (visibility) between vertices
-    size_t numVertices = cts_array_get_length(graph->adjacency);
-    for(size_t i = 0; i < numVertices; i++) {
+    bool r = calculate_obstacle_rows(graph);
+
+    // everything in the lists so far stays valid until the obstacles change
+    for(size_t i = 0; i < graph->n_obstacle_vertices; i++) {
         AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
-        for(size_t j = 0; j < numVertices; j++) {
-            AdjacencyNode* n2 = (AdjacencyNode*)cts_array_get(graph->adjacency, j); 
-            if(n == n2) {
-                continue;
-            }
+        n->n_static = cts_slist_get_length(n->adjacent_points);
+    }
+    return r;
+}
 
-            if((n->polygon != NULL) && (n->polygon == n2->polygon)) {
-                continue;
-            }
+static bool append_if_visible(Graph* graph, AdjacencyNode* n, AdjacencyNode* n2) {
+    if(bitangent(graph, n, n2) && is_visible(graph, n, n2)) {
+        return cts_slist_append(n->adjacent_points, n2->root);
+    }
+    return true;
+}
 
-            if(is_visible(graph, n, n2)) {
-                //adjacency_node_ref(n2);
-                cts_slist_append(n->adjacent_points, n2->root);
-            }
+// connects start and end to the cached obstacle graph, O(V*E)
+static bool calculate_endpoint_visibility(Graph* graph) {
+    size_t n_obstacles = graph->n_obstacle_vertices;
+    AdjacencyNode* start = (AdjacencyNode*)cts_array_get(graph->adjacency, n_obstacles);
+    AdjacencyNode* end = (AdjacencyNode*)cts_array_get(graph->adjacency, n_obstacles + 1);
+
+    start->root = graph->start_point;
+    end->root = graph->end_point;
+    cts_slist_truncate(start->adjacent_points, 0);
+    cts_slist_truncate(end->adjacent_points, 0);
+
+    // start and end come last in the adjacency array, so they also come last in each list
+    for(size_t i = 0; i < n_obstacles; i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+        cts_slist_truncate(n->adjacent_points, n->n_static);
+        if(!append_if_visible(graph, n, start) || !append_if_visible(graph, n, end)) {
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < n_obstacles; i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+        if(!append_if_visible(graph, start, n)) {
+            return false;
+        }
+    }
+    if(!append_if_visible(graph, start, end)) {
+        return false;
+    }
+
+    for(size_t i = 0; i < n_obstacles; i++) {
+        AdjacencyNode* n = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+        if(!append_if_visible(graph, end, n)) {
+            return false;
+        }
+    }
+    return append_if_visible(graph, end, start);
+}
+
+// the obstacle graph only changes when polygons are added
+static bool update_obstacles(Graph* graph) {
+    if(graph->obstacles_dirty) {
+        graph->obstacle_csr_valid = false;
+        if(!calculate_obstacle_visibility(graph)) {
+            return false;
+        }
+        graph->obstacles_dirty = false;
+        if(graph->path_table && !path_table_matches(graph->path_table, graph)) {
+            // built for other obstacles
+            path_table_unref(graph->path_table);
+            graph->path_table = NULL;
+        }
+    }
+    return true;
+}
+
+bool graph_calculate_visibility(Graph* graph) {
+    graph->csr_valid = false;
+
+    if(!update_obstacles(graph)) {
+        return false;
+    }
+
+    if(!calculate_endpoint_visibility(graph)) {
+        graph->obstacles_dirty = true;
+        return false;
+    }
+
+    if(graph->freeze_adjacency) {
+        // without memory for the frozen copy graph_get_path keeps using the lists
+        graph_freeze(graph);
+    }
+    return true;
+}
+
+bool graph_freeze(Graph* graph)
+{
+    if(graph->csr == NULL) {
+        graph->csr = csr_graph_new(cts_base_get_allocator((CtsBase*)graph));
+        if(graph->csr == NULL) {
+            return false;
         }
     }
+    graph->csr_valid = csr_graph_build(graph->csr, graph->adjacency);
+    return graph->csr_valid;
+}
+
+bool graph_freeze_obstacles(Graph* graph)
+{
+    if(!update_obstacles(graph)) {
+        return false;
+    }
+    if(graph->obstacle_csr_valid) {
+        return true;
+    }
+    if(graph->obstacle_csr == NULL) {
+        graph->obstacle_csr = csr_graph_new(cts_base_get_allocator((CtsBase*)graph));
+        if(graph->obstacle_csr == NULL) {
+            return false;
+        }
+    }
+    graph->obstacle_csr_valid = csr_graph_build_static(graph->obstacle_csr, graph->adjacency, graph->n_obstacle_vertices);
+    return graph->obstacle_csr_valid;
+}
+
+void graph_set_freeze(Graph* graph, bool freeze)
+{
+    graph->freeze_adjacency = freeze;
+}
+
+size_t graph_get_polygons_skipped(Graph* graph)
+{
+    return graph->n_polygons_skipped + graph->obstacle_edges->n_groups_skipped;
+}
+
+void graph_set_spatial_index(Graph* graph, bool enable)
+{
+    graph->use_spatial_index = enable;
+    graph->obstacles_dirty = true;
+}
+
+void graph_set_thread_count(Graph* graph, size_t n_threads)
+{
+    graph->n_threads = n_threads;
+}
+
+void graph_set_inflation(Graph* graph, double radius, PolygonInflateShape shape, size_t n_segments)
+{
+    graph->inflate_radius = radius;
+    graph->inflate_shape = shape;
+    graph->inflate_segments = n_segments;
+    graph->obstacles_dirty = true;
+    graph->obstacle_edges_valid = false;
+}
+
+void graph_set_visibility_mode(Graph* graph, GraphVisibilityMode mode)
+{
+    graph->visibility_mode = mode;
+    graph->obstacles_dirty = true;
+}
+
+void graph_set_reduced(Graph* graph, bool reduced)
+{
+    graph->reduced = reduced;
+    graph->obstacles_dirty = true;
 }
 
 void graph_print(Graph* graph) {
@@ -322,40 +820,104 @@ AdjacencyNode* get_adjacency_node(Graph* graph, Point* point) {
     return (AdjacencyNode*) cts_hash_map_get(graph->point_to_adjacency_map, point);
 }
 
-void release_graph_nodes(CtsArray* nodes) {
-    for(size_t i = 0; i < cts_array_get_length(nodes); i++) {
-        GraphNode* node = (GraphNode*)cts_array_get(nodes, i);
-        graph_node_unref(node);
+// A* over the frozen graph with vertex indices, see path_search.h
+static CtsArray* graph_get_path_csr(Graph* graph) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) graph);
+    CtsArray* path = cts_array_new(alloc);
+    if(path == NULL) {
+        return NULL;
+    }
+
+    if(graph->search == NULL) {
+        graph->search = path_search_new(alloc);
+        if(graph->search == NULL) {
+            return path;
+        }
+    }
+
+    // start and end are the last two vertices
+    size_t n_vertices = graph->csr->n_vertices;
+    path_search_set_queue(graph->search, graph->path_queue);
+    path_search_set_bidirectional(graph->search, graph->bidirectional_search);
+    if(path_search_find(graph->search, graph->csr, n_vertices - 2, n_vertices - 1)) {
+        if(!path_search_append_path(graph->search, graph->csr, n_vertices - 1, path)) {
+            cts_array_free(path);
+        }
+    }
+    graph->n_expanded = graph->search->n_expanded;
+    return path;
+}
+
+bool graph_get_distances(Graph* graph, size_t source, double* distances, size_t* predecessors) {
+    graph->n_expanded = 0;
+    if(!graph->csr_valid && !graph_freeze(graph)) {
+        return false;
+    }
+    if(graph->search == NULL) {
+        graph->search = path_search_new(cts_base_get_allocator((CtsBase*) graph));
+        if(graph->search == NULL) {
+            return false;
+        }
     }
+    bool r = path_search_dijkstra(graph->search, graph->csr, source);
+    graph->n_expanded = graph->search->n_expanded;
+    return r && path_search_get_distances(graph->search, graph->csr, distances, predecessors);
+}
+
+void graph_set_bidirectional(Graph* graph, bool bidirectional) {
+    graph->bidirectional_search = bidirectional;
+}
+
+void graph_set_path_queue(Graph* graph, PathSearchQueue queue) {
+    graph->path_queue = queue;
+}
+
+size_t graph_get_expanded_count(Graph* graph) {
+    return graph->n_expanded;
 }
 
 CtsArray* graph_get_path(Graph* graph) {
     CtsAllocator* alloc = cts_base_get_allocator((CtsBase*) graph);
-    graph->point_to_adjacency_map = cts_hash_map_new_full(alloc, point_hash_func, points_equal, NULL, NULL, NULL, NULL);
-    
-    for (size_t i = 0; i < cts_array_get_length(graph->adjacency); i++) {
-        AdjacencyNode* adj_node = (AdjacencyNode*) cts_array_get(graph->adjacency, i);
-        cts_hash_map_set(graph->point_to_adjacency_map, adj_node->root, adj_node);
+    graph->n_expanded = 0;
+    if(graph->csr_valid) {
+        return graph_get_path_csr(graph);
+    }
+
+    CtsArray* path = cts_array_new(alloc);
+    if(path == NULL) {
+        return NULL;
+    }
+
+    // a vertex gets one GraphNode per search plus one each time its cost improves, so they mostly fit
+    // one block of an arena that is dropped in one go at the end. the maps and the open set grow by
+    // realloc and stay off the arena, which would keep every table they give up until the end
+    size_t n_points = cts_array_get_length(graph->adjacency);
+    size_t node_size = (sizeof(GraphNode) + 7) & ~(size_t)7;
+    CtsAllocator* nodes = cts_allocator_arena_new(alloc, n_points * node_size);
+    if(nodes == NULL) {
+        return path;
     }
+    CtsSListIterator* iter = NULL;
 
+    graph->point_to_adjacency_map = cts_hash_map_new_full(alloc, point_hash_func, points_equal, NULL, NULL, NULL, NULL);
     CtsPriorityQueue* openSet = cts_priority_queue_new_full(alloc, (HeapCompareFunc) compare_graph_nodes, NULL, NULL);
     CtsHashMap* openSetMap = cts_hash_map_new_full(alloc, point_hash_func, points_equal, NULL, NULL, NULL, NULL);
     CtsHashMap* closedSet = cts_hash_map_new_full(alloc, point_hash_func, points_equal, NULL, NULL, NULL, NULL);
-    CtsArray* graph_nodes = cts_array_new(alloc);
+    if(!graph->point_to_adjacency_map || !openSet || !openSetMap || !closedSet) {
+        goto cleanup;
+    }
 
-    CtsArray* path = cts_array_new(alloc);
+    for (size_t i = 0; i < cts_array_get_length(graph->adjacency); i++) {
+        AdjacencyNode* adj_node = (AdjacencyNode*) cts_array_get(graph->adjacency, i);
+        cts_hash_map_set(graph->point_to_adjacency_map, adj_node->root, adj_node);
+    }
 
     // Create a GraphNode for the start point and add it to the open set
-    GraphNode* start_node = graph_node_new(alloc);
+    GraphNode* start_node = graph_node_new(nodes);
     if(start_node == NULL) {
         goto cleanup;
     }
 
-    if(!cts_array_append(graph_nodes, start_node)) {
-        goto cleanup;
-    }
-
-    size_t n_points = cts_array_get_length(graph->adjacency);
     start_node->point = cts_array_get(graph->adjacency, n_points-2);
     start_node->g_cost = 0.0;
     start_node->h_cost = heuristic(start_node->point->root, graph->end_point);
@@ -366,7 +928,12 @@ CtsArray* graph_get_path(Graph* graph) {
 
     while (!cts_priority_queue_is_empty(openSet)) {
         GraphNode* current_node = (GraphNode*) cts_priority_queue_pop(openSet);
+        // nodes left behind by a cost improvement are no longer in the open set map, skip them
+        if(cts_hash_map_get(openSetMap, current_node->point->root) != current_node) {
+            continue;
+        }
         cts_hash_map_remove(openSetMap, current_node->point->root);
+        graph->n_expanded++;
 
         // If the current node is the end point, construct the path and return
         if (points_equal(current_node->point->root, graph->end_point)) {
@@ -383,7 +950,7 @@ CtsArray* graph_get_path(Graph* graph) {
             goto cleanup;
         }
 
-        CtsSListIterator* iter = cts_slist_iterator_new_from_list(alloc, current_node->point->adjacent_points);
+        iter = cts_slist_iterator_new_from_list(alloc, current_node->point->adjacent_points);
         if(iter == NULL) {
             goto cleanup;
         }
@@ -392,32 +959,26 @@ CtsArray* graph_get_path(Graph* graph) {
             if (cts_hash_map_contains(closedSet, neighbor_point)) continue;  // Ignore neighbors in the closed set
 
             double tentative_g_cost = current_node->g_cost + heuristic(current_node->point->root, neighbor_point);
-            GraphNode* graph_node_neighbor;
-
-            // If the neighbor is in the open set and the tentative g cost is less than the neighbor's current g cost, update the neighbor's cost and parent
-            if (cts_hash_map_contains(openSetMap, neighbor_point)) {
-                graph_node_neighbor = (GraphNode*) cts_hash_map_get(openSetMap, neighbor_point);
-                if (tentative_g_cost < graph_node_neighbor->g_cost) {
-                    graph_node_neighbor->g_cost = tentative_g_cost;
-                    graph_node_neighbor->parent = current_node;
-                }
-            } else {
-                // If the neighbor is not in the open set, create a new graph node for the neighbor and add it to the open set
-                graph_node_neighbor = graph_node_new(alloc);
-                if(graph_node_neighbor == NULL) {
-                    goto cleanup;
-                }
-                cts_array_append(graph_nodes, graph_node_neighbor);
-                graph_node_neighbor->point = (AdjacencyNode*) cts_hash_map_get(graph->point_to_adjacency_map, neighbor_point);
-                graph_node_neighbor->g_cost = tentative_g_cost;
-                graph_node_neighbor->h_cost = heuristic(neighbor_point, graph->end_point);
-                graph_node_neighbor->parent = current_node;
-                if(cts_hash_map_set(openSetMap, neighbor_point, graph_node_neighbor) == false) {
-                    goto cleanup;
-                }
-                if(cts_priority_queue_push(openSet, graph_node_neighbor) == false) {
-                    goto cleanup;
-                }
+
+            // Ignore neighbors already in the open set with a cost at least as good
+            GraphNode* graph_node_neighbor = (GraphNode*) cts_hash_map_get(openSetMap, neighbor_point);
+            if ((graph_node_neighbor != NULL) && (tentative_g_cost >= graph_node_neighbor->g_cost)) continue;
+
+            // The heap can't re-sift a node whose cost changed in place, so a neighbor reached more cheaply
+            // gets a new graph node just like a neighbor not yet in the open set
+            graph_node_neighbor = graph_node_new(nodes);
+            if(graph_node_neighbor == NULL) {
+                goto cleanup;
+            }
+            graph_node_neighbor->point = (AdjacencyNode*) cts_hash_map_get(graph->point_to_adjacency_map, neighbor_point);
+            graph_node_neighbor->g_cost = tentative_g_cost;
+            graph_node_neighbor->h_cost = heuristic(neighbor_point, graph->end_point);
+            graph_node_neighbor->parent = current_node;
+            if(cts_hash_map_set(openSetMap, neighbor_point, graph_node_neighbor) == false) {
+                goto cleanup;
+            }
+            if(cts_priority_queue_push(openSet, graph_node_neighbor) == false) {
+                goto cleanup;
             }
         }
 
@@ -426,21 +987,37 @@ CtsArray* graph_get_path(Graph* graph) {
             goto cleanup;
         }
         cts_slist_iterator_unref(iter);
+        iter = NULL;
     }
 
     cleanup:
 
-    cts_priority_queue_clear(openSet);
-    cts_priority_queue_unref(openSet);
-    cts_hash_map_clear(openSetMap);
-    cts_hash_map_unref(openSetMap);
-    cts_hash_map_clear(closedSet);
-    cts_hash_map_unref(closedSet);
-    cts_hash_map_clear(graph->point_to_adjacency_map);
-    cts_hash_map_unref(graph->point_to_adjacency_map);
-    release_graph_nodes(graph_nodes);
-    cts_array_unref(graph_nodes);
-            
+    // the iterator holds a reference on its list
+    if(iter != NULL) {
+        cts_slist_iterator_unref(iter);
+    }
+
+    if(openSet) {
+        cts_priority_queue_clear(openSet);
+        cts_priority_queue_unref(openSet);
+    }
+    if(openSetMap) {
+        cts_hash_map_clear(openSetMap);
+        cts_hash_map_unref(openSetMap);
+    }
+    if(closedSet) {
+        cts_hash_map_clear(closedSet);
+        cts_hash_map_unref(closedSet);
+    }
+    if(graph->point_to_adjacency_map) {
+        cts_hash_map_clear(graph->point_to_adjacency_map);
+        cts_hash_map_unref(graph->point_to_adjacency_map);
+        graph->point_to_adjacency_map = NULL;
+    }
+
+    // graph nodes hold nothing outside the arena, so there's no need to take them apart
+    cts_allocator_arena_delete(nodes);
+
     return path;
 }
 
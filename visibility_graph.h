@@ -1,30 +1,106 @@
 #ifndef VISIBILITY_GRAPH_H
 #define VISIBILITY_GRAPH_H
 
+#include <math.h>
 #include <Cts/cts.h>
 #include "polygon.h"
+#include "segment_batch.h"
+#include "obstacle_grid.h"
+#include "csr_graph.h"
+#include "path_search.h"
 
 CTS_BEGIN_DECLARE_TYPE(CtsBase, AdjacencyNode, adjacency_node)
 Point* root;
 CtsSList* adjacent_points;
 Polygon* polygon;
+Point* side_prev; // neighbours along the polygon, NULL for start and end
+Point* side_next;
+bool reflex; // the polygon turns inwards here, reduced graphs leave the vertex without links
+size_t n_static; // leading entries of adjacent_points that link obstacle vertices, the rest link start/end
 CTS_END_DECLARE_TYPE(AdjacencyNode, adjacency_node)
 
 
+// on the bench scenes the sweep catches up with brute force without the spatial index at ~900 vertices
+// (1.3x faster at 1550, 2.3x at 3500). brute force with the index, the default, stays ~1.7x faster than
+// the sweep up to at least 3500 vertices, so the sweep is for graphs built without the index
+typedef enum GraphVisibilityMode {
+    GRAPH_VISIBILITY_BRUTE_FORCE, // test every vertex pair against every polygon edge, O(n^3)
+    GRAPH_VISIBILITY_SWEEP // Lee's rotational plane sweep, O(n^2 log n), same adjacency lists
+} GraphVisibilityMode;
+
 CTS_BEGIN_DECLARE_TYPE(CtsBase, Graph, graph)
 CtsArray* polygons; // array of Polygon*
+double inflate_radius; // 0 to use polygons as they are, see graph_set_inflation
+PolygonInflateShape inflate_shape;
+size_t inflate_segments;
+CtsArray* inflated; // inflated and merged polygons, rebuilt with the obstacle graph
 Point* start_point;
 Point* end_point;
 CtsArray* adjacency; // adjacency list
 CtsHashMap* point_to_adjacency_map;
+GraphVisibilityMode visibility_mode;
+bool reduced; // only bitangent links, see graph_set_reduced
+size_t n_obstacle_vertices; // start and end follow the obstacle vertices in adjacency
+bool obstacles_dirty; // set by graph_add_polygon, the obstacle graph is rebuilt on the next graph_calculate_visibility
+size_t n_threads; // threads used to build the obstacle graph, 0 uses every online core
+SegmentBatch* obstacle_edges; // every polygon edge, packed for is_visible
+bool obstacle_edges_valid; // false until obstacle_edges is rebuilt after graph_add_polygon
+ObstacleGrid* obstacle_grid; // NULL when there are too few edges or use_spatial_index is off
+bool use_spatial_index;
+size_t n_polygons_skipped; // polygons is_visible ruled out by their bounding box, see graph_get_polygons_skipped
+CsrGraph* csr; // frozen copy of the adjacency lists
+bool freeze_adjacency; // refreeze after every graph_calculate_visibility
+bool csr_valid; // csr matches the lists, graph_get_path uses it
+CsrGraph* obstacle_csr; // frozen obstacle graph without start and end, for queries between arbitrary points
+bool obstacle_csr_valid;
+struct PathTable* path_table; // all pairs table for obstacle_csr, see path_table.h. NULL if not in use
+PathSearch* search; // search state for the frozen graph, reused between queries
+PathSearchQueue path_queue; // open set used by search
+bool bidirectional_search; // search frozen graphs from both ends
+size_t n_expanded; // vertices expanded by the last graph_get_path
 CTS_END_DECLARE_TYPE(Graph, graph) 
 
 void graph_add_polygon(Graph* graph, Polygon* polygon);
+// links every pair of vertices that see each other. two vertices of one polygon are linked when the
+// line between them runs outside it, across a pocket of a concave polygon
 bool graph_calculate_visibility(Graph* graph);
+void graph_set_visibility_mode(Graph* graph, GraphVisibilityMode mode);
+// keep only links that can be part of a shortest path: reflex vertices get none, and a link has to
+// leave the polygon at each end without entering it (a bitangent). the vertices stay in adjacency so
+// indices don't change. rebuilt on the next graph_calculate_visibility. paths have the same length as
+// with every link as long as no obstacles overlap and start and end lie outside of them
+void graph_set_reduced(Graph* graph, bool reduced);
+// grow every polygon by radius (see polygon_new_inflated) and merge the ones that then overlap into their
+// convex hull, since obstacles are taken to be convex. the visibility graph is built over the result,
+// cached until polygons are added or the inflation changes. 0 turns it off. a start or end point that
+// ends up inside an inflated obstacle isn't moved out of it, so the path from it crosses the obstacle
+void graph_set_inflation(Graph* graph, double radius, PolygonInflateShape shape, size_t n_segments);
+// the polygons the visibility graph is built over, inflated or not
+CtsArray* graph_get_obstacles(Graph* graph);
+void graph_set_thread_count(Graph* graph, size_t n_threads);
+void graph_set_spatial_index(Graph* graph, bool enable);
+// copies the adjacency lists into csr for graph_get_path. valid until the next graph_calculate_visibility
+bool graph_freeze(Graph* graph);
+// brings the obstacle graph up to date and copies it into obstacle_csr, start and end aren't needed
+bool graph_freeze_obstacles(Graph* graph);
+// freeze automatically at the end of every graph_calculate_visibility
+void graph_set_freeze(Graph* graph, bool freeze);
+// open set for the frozen graph search, PATH_SEARCH_LAZY_HEAP by default
+void graph_set_path_queue(Graph* graph, PathSearchQueue queue);
+// search the frozen graph from start and end at once, see path_search.h. takes effect from the next query
+void graph_set_bidirectional(Graph* graph, bool bidirectional);
+// vertices the last graph_get_path expanded, frozen or not
+size_t graph_get_expanded_count(Graph* graph);
+// number of polygon tests is_visible skipped because the bounding boxes didn't overlap, since the graph was created
+size_t graph_get_polygons_skipped(Graph* graph);
 void graph_print(Graph* graph);
 void graph_set_start_point(Graph* graph, Point* point);
 void graph_set_end_point(Graph* graph, Point* point);
 CtsArray* graph_get_path(Graph* graph);
+// Dijkstra from vertex source of the adjacency array (n_obstacle_vertices is the start point) to every
+// vertex. distances and predecessors need cts_array_get_length(adjacency) entries, see
+// path_search_get_distances. freezes the graph first if it isn't
+bool graph_get_distances(Graph* graph, size_t source, double* distances, size_t* predecessors);
 
 
 CTS_BEGIN_DECLARE_TYPE(CtsBase, GraphNode, graph_node) 
@@ -39,6 +115,23 @@ typedef struct Edge {
     Point* to;
 } Edge;
 
+// straight line distance, used as the A* heuristic and as the cost of every link so the list based and
+// the frozen searches agree exactly. inline because the searches call it for every link they relax
+static inline double heuristic(Point* point1, Point* point2) {
+    double dx = (double)point1->x - point2->x;
+    double dy = (double)point1->y - point2->y;
+    return sqrt(dx*dx + dy*dy);
+}
+double orientation(Point* p, Point* q, Point* r);
+bool onSegment(Point* p, Point* q, Point* r);
+bool intersects(Edge* e1, Edge* e2);
+bool is_visible(Graph* graph, AdjacencyNode* n1, AdjacencyNode* n2);
+// true if no polygon edge blocks the line from one point to the other. safe to call from several threads
+bool graph_points_visible(Graph* graph, Point* from, Point* to);
+// false if the graph is reduced and a link from n towards point can't be on a shortest path, because n
+// is reflex or the line enters n's polygon. always true for start and end and for unreduced graphs
+bool graph_link_is_tangent(Graph* graph, AdjacencyNode* n, Point* point);
+
 
 CtsArray* find_path(CtsAllocator* alloc, Point* start, Point* end, Polygon** poly_list, size_t n_polygons);
 
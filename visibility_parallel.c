@@ -0,0 +1,235 @@
+#include "visibility_parallel.h"
+#include <string.h>
+
+#ifndef VISIBILITY_NO_THREADS
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct RowRange {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} RowRange;
+
+typedef struct Worker {
+    struct ParallelBuild* build;
+    size_t index;
+    void* pool;
+    CtsAllocator* alloc;
+    VisibilitySweep* sweep;
+    bool* row;
+    pthread_t thread;
+    bool started;
+} Worker;
+
+typedef struct ParallelBuild {
+    Graph* graph;
+    uint8_t* bitmap;
+    size_t stride;
+    size_t n_workers;
+    RowRange* ranges;
+    Worker* workers;
+} ParallelBuild;
+
+size_t visibility_parallel_thread_count(size_t n_threads) {
+    if(n_threads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (n > 0) ? (size_t)n : 1;
+    }
+    return n_threads;
+}
+
+static bool claim_row(RowRange* range, size_t* row) {
+    bool r = false;
+    pthread_mutex_lock(&range->lock);
+    if(range->next < range->end) {
+        *row = range->next++;
+        r = true;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return r;
+}
+
+// moves the upper half of the fullest other range into the worker's own (empty) range
+static bool steal_rows(ParallelBuild* build, size_t index) {
+    size_t victim = index;
+    size_t most = 0;
+    for(size_t i = 0; i < build->n_workers; i++) {
+        RowRange* range = &build->ranges[i];
+        pthread_mutex_lock(&range->lock);
+        size_t left = range->end - range->next;
+        pthread_mutex_unlock(&range->lock);
+        if((i != index) && (left > most)) {
+            most = left;
+            victim = i;
+        }
+    }
+    if(victim == index) {
+        return false;
+    }
+
+    RowRange* from = &build->ranges[victim];
+    size_t begin, end;
+    pthread_mutex_lock(&from->lock);
+    size_t left = from->end - from->next;
+    end = from->end;
+    begin = end - (left + 1) / 2;
+    from->end = begin;
+    pthread_mutex_unlock(&from->lock);
+
+    if(begin == end) {
+        // the victim finished its rows in the meantime, look again
+        return true;
+    }
+
+    RowRange* own = &build->ranges[index];
+    pthread_mutex_lock(&own->lock);
+    own->next = begin;
+    own->end = end;
+    pthread_mutex_unlock(&own->lock);
+    return true;
+}
+
+static void* run_worker(void* data) {
+    Worker* worker = (Worker*)data;
+    ParallelBuild* build = worker->build;
+    size_t n_rows = build->graph->n_obstacle_vertices;
+    size_t i;
+
+    do {
+        while(claim_row(&build->ranges[worker->index], &i)) {
+            graph_visibility_row(build->graph, worker->sweep, i, worker->row);
+
+            uint8_t* bits = &build->bitmap[i * build->stride];
+            memset(bits, 0, build->stride);
+            for(size_t j = 0; j < n_rows; j++) {
+                if(worker->row[j]) {
+                    bits[j / 8] |= (uint8_t)(1 << (j % 8));
+                }
+            }
+        }
+    } while(steal_rows(build, worker->index));
+    return NULL;
+}
+
+// scratch needed by one worker: the sweep's events, groups, cached edge distances and status tree nodes plus
+// the row buffer
+static size_t worker_pool_size(Graph* graph) {
+    size_t n = cts_array_get_length(graph->adjacency);
+    return 4096 + n * 160;
+}
+
+static bool worker_setup(Worker* worker, CtsAllocator* alloc, VisibilitySweep* sweep, size_t pool_size) {
+    Graph* graph = worker->build->graph;
+    worker->pool = cts_allocator_alloc(alloc, pool_size);
+    if(worker->pool == NULL) {
+        return false;
+    }
+    worker->alloc = cts_allocator_from_pool(worker->pool, pool_size);
+    if(worker->alloc == NULL) {
+        return false;
+    }
+    worker->row = (bool*)cts_allocator_alloc(worker->alloc, sizeof(bool) * cts_array_get_length(graph->adjacency));
+    if(worker->row == NULL) {
+        return false;
+    }
+    if(sweep != NULL) {
+        // a worker without a sweep still gets the right rows from the brute force build
+        worker->sweep = visibility_sweep_new_worker(worker->alloc, sweep);
+    }
+    return true;
+}
+
+static void worker_cleanup(Worker* worker, CtsAllocator* alloc) {
+    if(worker->sweep) {
+        visibility_sweep_unref(worker->sweep);
+    }
+    if(worker->row) {
+        cts_allocator_free(worker->alloc, worker->row);
+    }
+    if(worker->pool) {
+        cts_allocator_free(alloc, worker->pool);
+    }
+}
+
+bool visibility_parallel_rows(Graph* graph, VisibilitySweep* sweep, size_t n_threads, uint8_t* bitmap, size_t stride) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)graph);
+    size_t n_rows = graph->n_obstacle_vertices;
+    size_t pool_size = worker_pool_size(graph);
+
+    n_threads = visibility_parallel_thread_count(n_threads);
+    if(n_threads > n_rows) {
+        n_threads = n_rows;
+    }
+    if(n_threads < 1) {
+        n_threads = 1;
+    }
+
+    ParallelBuild build = { graph, bitmap, stride, n_threads, NULL, NULL };
+    build.ranges = (RowRange*)cts_allocator_alloc(alloc, sizeof(RowRange) * n_threads);
+    build.workers = (Worker*)cts_allocator_alloc(alloc, sizeof(Worker) * n_threads);
+    if(!build.ranges || !build.workers) {
+        if(build.ranges) {
+            cts_allocator_free(alloc, build.ranges);
+        }
+        if(build.workers) {
+            cts_allocator_free(alloc, build.workers);
+        }
+        return false;
+    }
+
+    // worker memory comes from the graph's allocator, which is only used from this thread
+    bool r = true;
+    memset(build.workers, 0, sizeof(Worker) * n_threads);
+    for(size_t i = 0; i < n_threads; i++) {
+        build.workers[i].build = &build;
+        build.workers[i].index = i;
+        pthread_mutex_init(&build.ranges[i].lock, NULL);
+        build.ranges[i].next = n_rows * i / n_threads;
+        build.ranges[i].end = n_rows * (i + 1) / n_threads;
+        if(r) {
+            r = worker_setup(&build.workers[i], alloc, sweep, pool_size);
+        }
+    }
+
+    if(r) {
+        // ranges of threads that fail to start are stolen by the others
+        for(size_t i = 1; i < n_threads; i++) {
+            Worker* worker = &build.workers[i];
+            worker->started = (pthread_create(&worker->thread, NULL, run_worker, worker) == 0);
+        }
+        run_worker(&build.workers[0]);
+        for(size_t i = 1; i < n_threads; i++) {
+            if(build.workers[i].started) {
+                pthread_join(build.workers[i].thread, NULL);
+            }
+        }
+    }
+
+    for(size_t i = 0; i < n_threads; i++) {
+        worker_cleanup(&build.workers[i], alloc);
+        pthread_mutex_destroy(&build.ranges[i].lock);
+    }
+    cts_allocator_free(alloc, build.workers);
+    cts_allocator_free(alloc, build.ranges);
+    return r;
+}
+
+#else
+
+size_t visibility_parallel_thread_count(size_t n_threads) {
+    (void)n_threads;
+    return 1;
+}
+
+bool visibility_parallel_rows(Graph* graph, VisibilitySweep* sweep, size_t n_threads, uint8_t* bitmap, size_t stride) {
+    (void)graph;
+    (void)sweep;
+    (void)n_threads;
+    (void)bitmap;
+    (void)stride;
+    return false;
+}
+
+#endif
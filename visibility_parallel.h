@@ -0,0 +1,31 @@
+#ifndef VISIBILITY_PARALLEL_H
+#define VISIBILITY_PARALLEL_H
+
+#include <Cts/cts.h>
+#include <stdint.h>
+#include "visibility_graph.h"
+#include "visibility_sweep.h"
+
+/*
+ * Multithreaded build of the obstacle visibility rows.
+ *
+ * The obstacle rows are split into one range per thread. Each thread works through its own range
+ * and, once it runs dry, steals the upper half of what is left of another thread's range. Threads
+ * never touch the graph's allocator: every worker gets a pool allocator over its own slab for its
+ * sweep scratch and row buffer, and writes its rows as bits into a shared bitmap. Rows are only
+ * written by the thread that claimed them, so the bitmap needs no locking. The caller turns the
+ * bitmap into adjacency lists afterwards.
+ *
+ * Build with VISIBILITY_NO_THREADS for targets without pthreads, every build then runs on the
+ * calling thread. Cts has its own switch, CTS_NO_THREADS, and 'make NO_THREADS=1' sets both.
+ */
+
+// resolves a requested thread count, 0 meaning every online core
+size_t visibility_parallel_thread_count(size_t n_threads);
+
+// fills bit j of row i (bitmap[i * stride + j / 8]) for the first graph->n_obstacle_vertices rows.
+// sweep may be NULL for the brute force build. returns false if the workers couldn't be set up,
+// nothing has been computed in that case.
+bool visibility_parallel_rows(Graph* graph, VisibilitySweep* sweep, size_t n_threads, uint8_t* bitmap, size_t stride);
+
+#endif
@@ -0,0 +1,652 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "visibility_sweep.h"
+
+// relative tolerance used when comparing the nearest edge on the ray to a target vertex
+#define SWEEP_EPSILON 1e-9
+
+typedef struct SweepVertex {
+    Point* point;
+    Polygon* polygon;
+    size_t edges[2]; // incident edges
+    size_t n_edges;
+    bool duplicate; // another vertex has the same coordinates
+} SweepVertex;
+
+typedef struct SweepEdge {
+    size_t a;
+    size_t b;
+    size_t id;
+    double ex; // b - a
+    double ey;
+} SweepEdge;
+
+typedef struct SweepEvent {
+    double angle; // monotone in the angle, see pseudo_angle
+    double dx;
+    double dy;
+    double dist2;
+    size_t vertex;
+} SweepEvent;
+
+CTS_DEFINE_TYPE(CtsBase, cts_base, VisibilitySweep, visibility_sweep)
+
+// the status tree comparator needs the current ray. edges are shared between worker sweeps,
+// so the sweep being run is tracked per thread instead of per edge
+static _Thread_local VisibilitySweep* comparing_sweep = NULL;
+
+static int compare_sweep_edges(const void* pa, const void* pb);
+
+bool visibility_sweep_construct(VisibilitySweep* self) {
+    self->graph = NULL;
+    self->parent = NULL;
+    self->vertices = NULL;
+    self->edges = NULL;
+    self->events = NULL;
+    self->group_of = NULL;
+    self->edge_start = NULL;
+    self->edge_t = NULL;
+    self->edge_ray = NULL;
+    self->n_vertices = 0;
+    self->n_edges = 0;
+    self->ray = 0;
+    self->removing = false;
+    self->usable = false;
+    self->status = cts_rb_tree_new_full(cts_base_get_allocator((CtsBase*)self), compare_sweep_edges);
+    if(self->status == NULL) {
+        return false;
+    }
+    return true;
+}
+
+void visibility_sweep_destruct(VisibilitySweep* self) {
+    CtsAllocator* alloc = cts_base_get_allocator((CtsBase*)self);
+    cts_rb_tree_unref(self->status);
+    if(self->parent) {
+        visibility_sweep_unref(self->parent);
+    }
+    else {
+        if(self->vertices) {
+            cts_allocator_free(alloc, self->vertices);
+        }
+        if(self->edges) {
+            cts_allocator_free(alloc, self->edges);
+        }
+    }
+    if(self->events) {
+        cts_allocator_free(alloc, self->events);
+    }
+    if(self->group_of) {
+        cts_allocator_free(alloc, self->group_of);
+    }
+    if(self->edge_start) {
+        cts_allocator_free(alloc, self->edge_start);
+    }
+    if(self->edge_t) {
+        cts_allocator_free(alloc, self->edge_t);
+    }
+    if(self->edge_ray) {
+        cts_allocator_free(alloc, self->edge_ray);
+    }
+}
+
+static double cross(double ax, double ay, double bx, double by) {
+    return ax * by - ay * bx;
+}
+
+static SweepVertex* edge_from(VisibilitySweep* sweep, SweepEdge* e) {
+    return &sweep->vertices[e->a];
+}
+
+static SweepVertex* edge_to(VisibilitySweep* sweep, SweepEdge* e) {
+    return &sweep->vertices[e->b];
+}
+
+// distance of the edge along the current ray, in units of the ray direction. the status comparisons
+// ask for the same edges over and over while the ray stands still
+static double edge_distance(VisibilitySweep* sweep, SweepEdge* e) {
+    if(sweep->edge_ray[e->id] == sweep->ray) {
+        return sweep->edge_t[e->id];
+    }
+    Point* a = edge_from(sweep, e)->point;
+    double t = cross(a->x - sweep->px, a->y - sweep->py, e->ex, e->ey) / cross(sweep->rx, sweep->ry, e->ex, e->ey);
+    sweep->edge_t[e->id] = t;
+    sweep->edge_ray[e->id] = sweep->ray;
+    return t;
+}
+
+static void set_ray(VisibilitySweep* sweep, double rx, double ry) {
+    sweep->rx = rx;
+    sweep->ry = ry;
+    sweep->ray++;
+}
+
+static size_t other_end(SweepEdge* e, size_t v) {
+    return (e->a == v) ? e->b : e->a;
+}
+
+static int compare_sweep_edges(const void* pa, const void* pb) {
+    SweepEdge* e1 = (SweepEdge*)pa;
+    SweepEdge* e2 = (SweepEdge*)pb;
+    VisibilitySweep* sweep = comparing_sweep;
+
+    if(e1 == e2) {
+        return 0;
+    }
+
+    // two edges meeting at a vertex on the ray are the same distance away.
+    // order them by which one is nearer just after the ray (inserting) or just before it (removing)
+    size_t shared = SIZE_MAX;
+    if(e1->a == e2->a || e1->a == e2->b) {
+        shared = e1->a;
+    } else if(e1->b == e2->a || e1->b == e2->b) {
+        shared = e1->b;
+    }
+    if((shared != SIZE_MAX) && (sweep->group_of[shared] == sweep->current_group)) {
+        Point* u = sweep->vertices[shared].point;
+        Point* o1 = sweep->vertices[other_end(e1, shared)].point;
+        Point* o2 = sweep->vertices[other_end(e2, shared)].point;
+        double c = cross((double)o1->x - u->x, (double)o1->y - u->y, (double)o2->x - u->x, (double)o2->y - u->y);
+        if(sweep->removing) {
+            c = -c;
+        }
+        if(c < 0) return -1;
+        if(c > 0) return 1;
+    } else {
+        double d1 = edge_distance(sweep, e1);
+        double d2 = edge_distance(sweep, e2);
+        if(d1 < d2) return -1;
+        if(d1 > d2) return 1;
+    }
+    return (e1->id < e2->id) ? -1 : 1;
+}
+
+static int half_plane(double dx, double dy) {
+    // angles in (-pi, 0] come first, then (0, pi]
+    return (dy < 0 || (dy == 0 && dx > 0)) ? 0 : 1;
+}
+
+static int compare_sweep_events(const void* pa, const void* pb) {
+    const SweepEvent* a = (const SweepEvent*)pa;
+    const SweepEvent* b = (const SweepEvent*)pb;
+    int ha = half_plane(a->dx, a->dy);
+    int hb = half_plane(b->dx, b->dy);
+    if(ha != hb) {
+        return ha - hb;
+    }
+    double c = cross(a->dx, a->dy, b->dx, b->dy);
+    if(c > 0) return -1;
+    if(c < 0) return 1;
+    if(a->dist2 < b->dist2) return -1;
+    if(a->dist2 > b->dist2) return 1;
+    return (a->vertex > b->vertex) - (a->vertex < b->vertex);
+}
+
+// increases with the angle of (dx, dy) over (-pi, pi] like atan2, without the trigonometry. rounding can
+// put nearly parallel directions out of order, the insertion pass in sort_events fixes that
+static double pseudo_angle(double dx, double dy) {
+    double t = dy / (fabs(dx) + fabs(dy));
+    if(dx >= 0) {
+        return t;
+    }
+    return (dy >= 0) ? 2 - t : -2 - t;
+}
+
+static int compare_event_keys(const void* pa, const void* pb) {
+    const SweepEvent* a = (const SweepEvent*)pa;
+    const SweepEvent* b = (const SweepEvent*)pb;
+    if(a->angle != b->angle) {
+        return (a->angle < b->angle) ? -1 : 1;
+    }
+    if(a->dist2 != b->dist2) {
+        return (a->dist2 < b->dist2) ? -1 : 1;
+    }
+    return (a->vertex > b->vertex) - (a->vertex < b->vertex);
+}
+
+// partitions shorter than this are left to the insertion pass
+#define SWEEP_SORT_RUN 16
+
+static void swap_events(SweepEvent* a, SweepEvent* b) {
+    SweepEvent t = *a;
+    *a = *b;
+    *b = t;
+}
+
+// quicksort on the pseudo angle that stops at short partitions. qsort takes over partitions that keep
+// splitting badly
+static void sort_event_keys(SweepEvent* events, size_t n_events, size_t depth) {
+    while(n_events > SWEEP_SORT_RUN) {
+        if(depth == 0) {
+            qsort(events, n_events, sizeof(SweepEvent), compare_event_keys);
+            return;
+        }
+        depth--;
+
+        // median of three as the pivot, moved to the end
+        size_t mid = n_events / 2;
+        size_t last = n_events - 1;
+        if(events[mid].angle < events[0].angle) swap_events(&events[mid], &events[0]);
+        if(events[last].angle < events[0].angle) swap_events(&events[last], &events[0]);
+        if(events[last].angle < events[mid].angle) swap_events(&events[last], &events[mid]);
+        swap_events(&events[mid], &events[last]);
+        double pivot = events[last].angle;
+
+        size_t store = 0;
+        for(size_t i = 0; i < last; i++) {
+            if(events[i].angle < pivot) {
+                swap_events(&events[i], &events[store++]);
+            }
+        }
+        swap_events(&events[store], &events[last]);
+
+        // recurse into the smaller side
+        if(store < n_events - store - 1) {
+            sort_event_keys(events, store, depth);
+            events += store + 1;
+            n_events -= store + 1;
+        }
+        else {
+            sort_event_keys(events + store + 1, n_events - store - 1, depth);
+            n_events = store;
+        }
+    }
+}
+
+// the order of compare_sweep_events. sorting on the pseudo angle leaves few events out of place, and
+// short partitions unsorted, both are cheap for the insertion pass
+static void sort_events(SweepEvent* events, size_t n_events) {
+    size_t depth = 0;
+    for(size_t n = n_events; n > 1; n >>= 1) {
+        depth += 2;
+    }
+    sort_event_keys(events, n_events, depth);
+    for(size_t k = 1; k < n_events; k++) {
+        SweepEvent ev = events[k];
+        size_t j = k;
+        while((j > 0) && (compare_sweep_events(&events[j - 1], &ev) > 0)) {
+            events[j] = events[j - 1];
+            j--;
+        }
+        events[j] = ev;
+    }
+}
+
+static bool same_direction(const SweepEvent* a, const SweepEvent* b) {
+    return (half_plane(a->dx, a->dy) == half_plane(b->dx, b->dy)) &&
+        (cross(a->dx, a->dy, b->dx, b->dy) == 0);
+}
+
+static bool edges_touch(VisibilitySweep* sweep, SweepEdge* e1, SweepEdge* e2) {
+    Edge pe1 = { edge_from(sweep, e1)->point, edge_to(sweep, e1)->point };
+    Edge pe2 = { edge_from(sweep, e2)->point, edge_to(sweep, e2)->point };
+
+    if(e1->a == e2->a || e1->a == e2->b || e1->b == e2->a || e1->b == e2->b) {
+        // neighbouring edges may only meet at their shared vertex, not fold back over each other
+        size_t shared = (e1->a == e2->a || e1->a == e2->b) ? e1->a : e1->b;
+        Point* u = sweep->vertices[shared].point;
+        Point* o1 = sweep->vertices[other_end(e1, shared)].point;
+        Point* o2 = sweep->vertices[other_end(e2, shared)].point;
+        double dx1 = (double)o1->x - u->x, dy1 = (double)o1->y - u->y;
+        double dx2 = (double)o2->x - u->x, dy2 = (double)o2->y - u->y;
+        return (cross(dx1, dy1, dx2, dy2) == 0) && (dx1 * dx2 + dy1 * dy2 > 0);
+    }
+    return intersects(&pe1, &pe2);
+}
+
+static bool check_usable(VisibilitySweep* sweep) {
+    CtsArray* obstacles = graph_get_obstacles(sweep->graph);
+    size_t n_polygons = cts_array_get_length(obstacles);
+    for(size_t i = 0; i < n_polygons; i++) {
+        Polygon* polygon = (Polygon*)cts_array_get(obstacles, i);
+        if(polygon_size(polygon) < 3) {
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < sweep->n_edges; i++) {
+        for(size_t j = i + 1; j < sweep->n_edges; j++) {
+            if(edges_touch(sweep, &sweep->edges[i], &sweep->edges[j])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// per row scratch: events and groups per vertex, start and cached distance per edge. a polygon has as
+// many edges as vertices
+static bool alloc_row_scratch(VisibilitySweep* sweep, CtsAllocator* alloc, size_t n_vertices) {
+    sweep->events = cts_allocator_alloc(alloc, sizeof(SweepEvent) * n_vertices);
+    sweep->group_of = cts_allocator_alloc(alloc, sizeof(size_t) * n_vertices);
+    sweep->edge_start = cts_allocator_alloc(alloc, sizeof(size_t) * n_vertices);
+    sweep->edge_t = cts_allocator_alloc(alloc, sizeof(double) * n_vertices);
+    sweep->edge_ray = cts_allocator_alloc(alloc, sizeof(size_t) * n_vertices);
+    if(!sweep->events || !sweep->group_of || !sweep->edge_start || !sweep->edge_t || !sweep->edge_ray) {
+        return false;
+    }
+    // ray 0 is never swept, nothing counts as cached yet
+    memset(sweep->edge_ray, 0, sizeof(size_t) * n_vertices);
+    return true;
+}
+
+static int compare_positions(const void* pa, const void* pb) {
+    const SweepEvent* a = (const SweepEvent*)pa;
+    const SweepEvent* b = (const SweepEvent*)pb;
+    if(a->dx != b->dx) {
+        return (a->dx < b->dx) ? -1 : 1;
+    }
+    if(a->dy != b->dy) {
+        return (a->dy < b->dy) ? -1 : 1;
+    }
+    return 0;
+}
+
+// flags vertices that share their coordinates with another one, sorting them by position in the
+// event buffer, which isn't in use yet
+static void find_duplicates(VisibilitySweep* sweep) {
+    SweepEvent* sorted = sweep->events;
+    for(size_t i = 0; i < sweep->n_vertices; i++) {
+        sorted[i].dx = sweep->vertices[i].point->x;
+        sorted[i].dy = sweep->vertices[i].point->y;
+        sorted[i].vertex = i;
+    }
+    qsort(sorted, sweep->n_vertices, sizeof(SweepEvent), compare_positions);
+    for(size_t i = 1; i < sweep->n_vertices; i++) {
+        if(compare_positions(&sorted[i - 1], &sorted[i]) == 0) {
+            sweep->vertices[sorted[i - 1].vertex].duplicate = true;
+            sweep->vertices[sorted[i].vertex].duplicate = true;
+        }
+    }
+}
+
+VisibilitySweep* visibility_sweep_new_from_graph(CtsAllocator* alloc, Graph* graph) {
+    VisibilitySweep* sweep = visibility_sweep_new(alloc);
+    if(sweep == NULL) {
+        return NULL;
+    }
+    sweep->graph = graph;
+
+    // only obstacle rows are swept, start and end may not even be set yet
+    size_t n_vertices = graph->n_obstacle_vertices;
+    sweep->vertices = cts_allocator_alloc(alloc, sizeof(SweepVertex) * n_vertices);
+    sweep->edges = cts_allocator_alloc(alloc, sizeof(SweepEdge) * n_vertices);
+    if(!sweep->vertices || !sweep->edges || !alloc_row_scratch(sweep, alloc, n_vertices)) {
+        visibility_sweep_unref(sweep);
+        return NULL;
+    }
+    sweep->n_vertices = n_vertices;
+
+    for(size_t i = 0; i < n_vertices; i++) {
+        AdjacencyNode* an = (AdjacencyNode*)cts_array_get(graph->adjacency, i);
+        sweep->vertices[i].point = an->root;
+        sweep->vertices[i].polygon = an->polygon;
+        sweep->vertices[i].n_edges = 0;
+        sweep->vertices[i].duplicate = false;
+    }
+    find_duplicates(sweep);
+
+    // polygon vertices are laid out contiguously in the adjacency array, so each one
+    // has an edge to the next vertex of the same run
+    size_t first = 0;
+    while(first < n_vertices) {
+        Polygon* polygon = sweep->vertices[first].polygon;
+        if(polygon == NULL) {
+            first++;
+            continue;
+        }
+        size_t n_points = polygon_size(polygon);
+        for(size_t j = 0; j < n_points; j++) {
+            size_t a = first + j;
+            size_t b = first + (j + 1) % n_points;
+            SweepEdge* e = &sweep->edges[sweep->n_edges];
+            e->a = a;
+            e->b = b;
+            e->id = sweep->n_edges;
+            e->ex = (double)sweep->vertices[b].point->x - sweep->vertices[a].point->x;
+            e->ey = (double)sweep->vertices[b].point->y - sweep->vertices[a].point->y;
+            sweep->vertices[a].edges[sweep->vertices[a].n_edges++] = e->id;
+            sweep->vertices[b].edges[sweep->vertices[b].n_edges++] = e->id;
+            sweep->n_edges++;
+        }
+        first += n_points;
+    }
+
+    sweep->usable = check_usable(sweep);
+    return sweep;
+}
+
+VisibilitySweep* visibility_sweep_new_worker(CtsAllocator* alloc, VisibilitySweep* parent) {
+    VisibilitySweep* sweep = visibility_sweep_new(alloc);
+    if(sweep == NULL) {
+        return NULL;
+    }
+    visibility_sweep_ref(parent);
+    sweep->parent = parent;
+    sweep->graph = parent->graph;
+    sweep->vertices = parent->vertices;
+    sweep->edges = parent->edges;
+    sweep->n_vertices = parent->n_vertices;
+    sweep->n_edges = parent->n_edges;
+    sweep->usable = parent->usable;
+
+    if(!alloc_row_scratch(sweep, alloc, sweep->n_vertices)) {
+        visibility_sweep_unref(sweep);
+        return NULL;
+    }
+    return sweep;
+}
+
+bool visibility_sweep_is_usable(VisibilitySweep* sweep) {
+    return sweep->usable;
+}
+
+static bool edge_touches_source(SweepEdge* e, size_t source) {
+    return (e->a == source) || (e->b == source);
+}
+
+// which end of each edge the sweep reaches first; the edge is in the status between the two. edges
+// touching the source or lying on a ray from it never enter the status and get NO_START
+#define NO_START SIZE_MAX
+
+static void classify_edges(VisibilitySweep* sweep, size_t source) {
+    for(size_t i = 0; i < sweep->n_edges; i++) {
+        SweepEdge* e = &sweep->edges[i];
+        Point* a = edge_from(sweep, e)->point;
+        Point* b = edge_to(sweep, e)->point;
+        double c = cross(a->x - sweep->px, a->y - sweep->py, b->x - sweep->px, b->y - sweep->py);
+        if(edge_touches_source(e, source) || (c == 0)) {
+            sweep->edge_start[i] = NO_START;
+        }
+        else {
+            sweep->edge_start[i] = (c > 0) ? e->a : e->b;
+        }
+    }
+}
+
+static bool source_is_clear(VisibilitySweep* sweep, size_t source) {
+    Point* p = sweep->vertices[source].point;
+    if(sweep->vertices[source].duplicate) {
+        return false;
+    }
+    if(sweep->vertices[source].polygon != NULL) {
+        // polygon vertices were already checked against every other edge
+        return true;
+    }
+    for(size_t i = 0; i < sweep->n_edges; i++) {
+        Point* a = edge_from(sweep, &sweep->edges[i])->point;
+        Point* b = edge_to(sweep, &sweep->edges[i])->point;
+        if((orientation(a, b, p) == 0) && onSegment(a, p, b)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool query_vertex(VisibilitySweep* sweep, size_t source, size_t group_begin, size_t group_end, size_t k) {
+    SweepEvent* target = &sweep->events[k];
+    size_t w = target->vertex;
+    Edge sight = { sweep->vertices[source].point, sweep->vertices[w].point };
+
+    // other vertices on the same ray sit on the line of sight; their edges touch it
+    for(size_t i = group_begin; i < group_end; i++) {
+        SweepEvent* ev = &sweep->events[i];
+        if((ev->vertex == w) || (ev->dist2 > target->dist2)) {
+            continue;
+        }
+        SweepVertex* u = &sweep->vertices[ev->vertex];
+        for(size_t j = 0; j < u->n_edges; j++) {
+            SweepEdge* e = &sweep->edges[u->edges[j]];
+            if(edge_touches_source(e, source) || (e->a == w) || (e->b == w)) {
+                continue;
+            }
+            Edge poly_edge = { edge_from(sweep, e)->point, edge_to(sweep, e)->point };
+            if(intersects(&sight, &poly_edge)) {
+                return false;
+            }
+        }
+    }
+
+    SweepEdge* nearest = (SweepEdge*)cts_rb_tree_minimum(sweep->status);
+    if(nearest == NULL) {
+        return true;
+    }
+    double t_nearest = edge_distance(sweep, nearest);
+    double t_target = (target->dx * sweep->rx + target->dy * sweep->ry) / (sweep->rx * sweep->rx + sweep->ry * sweep->ry);
+    if(t_nearest > t_target * (1.0 + SWEEP_EPSILON)) {
+        return true;
+    }
+    // the nearest edge crosses the ray well before the target
+    if(t_nearest < t_target * (1.0 - SWEEP_EPSILON)) {
+        return false;
+    }
+
+    Edge poly_edge = { edge_from(sweep, nearest)->point, edge_to(sweep, nearest)->point };
+    if(intersects(&sight, &poly_edge)) {
+        return false;
+    }
+
+    // the sweep and the exact predicate disagree, let the exact predicate decide
+    AdjacencyNode* n1 = (AdjacencyNode*)cts_array_get(sweep->graph->adjacency, source);
+    AdjacencyNode* n2 = (AdjacencyNode*)cts_array_get(sweep->graph->adjacency, w);
+    return is_visible(sweep->graph, n1, n2);
+}
+
+static bool sweep_row(VisibilitySweep* sweep, size_t source, bool* row) {
+    Point* p = sweep->vertices[source].point;
+    Polygon* polygon = sweep->vertices[source].polygon;
+    sweep->px = p->x;
+    sweep->py = p->y;
+
+    // sort every other vertex by angle around the source
+    size_t n_events = 0;
+    for(size_t i = 0; i < sweep->n_vertices; i++) {
+        if(i == source) {
+            continue;
+        }
+        Point* q = sweep->vertices[i].point;
+        SweepEvent* ev = &sweep->events[n_events++];
+        ev->dx = (double)q->x - p->x;
+        ev->dy = (double)q->y - p->y;
+        ev->dist2 = ev->dx * ev->dx + ev->dy * ev->dy;
+        ev->angle = pseudo_angle(ev->dx, ev->dy);
+        ev->vertex = i;
+    }
+    sort_events(sweep->events, n_events);
+
+    size_t n_groups = 0;
+    for(size_t k = 0; k < n_events; k++) {
+        if((k > 0) && !same_direction(&sweep->events[k - 1], &sweep->events[k])) {
+            n_groups++;
+        }
+        sweep->group_of[sweep->events[k].vertex] = n_groups;
+    }
+    sweep->group_of[source] = SIZE_MAX;
+
+    // edges crossing the ray pointing at -pi are already in the status when the sweep begins
+    classify_edges(sweep, source);
+    set_ray(sweep, -1.0, 0.0);
+    sweep->current_group = n_groups;
+    sweep->removing = false;
+    for(size_t i = 0; i < sweep->n_edges; i++) {
+        SweepEdge* e = &sweep->edges[i];
+        size_t start = sweep->edge_start[i];
+        if(start == NO_START) {
+            continue;
+        }
+        if(sweep->group_of[other_end(e, start)] < sweep->group_of[start]) {
+            if(!cts_rb_tree_insert(sweep->status, e, e)) {
+                return false;
+            }
+        }
+    }
+
+    size_t group_begin = 0;
+    size_t group = 0;
+    while(group_begin < n_events) {
+        size_t group_end = group_begin + 1;
+        while((group_end < n_events) && (sweep->group_of[sweep->events[group_end].vertex] == group)) {
+            group_end++;
+        }
+        set_ray(sweep, sweep->events[group_begin].dx, sweep->events[group_begin].dy);
+        sweep->current_group = group;
+
+        // edges that end on this ray leave the status
+        sweep->removing = true;
+        for(size_t k = group_begin; k < group_end; k++) {
+            size_t v = sweep->events[k].vertex;
+            SweepVertex* sv = &sweep->vertices[v];
+            for(size_t j = 0; j < sv->n_edges; j++) {
+                size_t start = sweep->edge_start[sv->edges[j]];
+                if((start == NO_START) || (start == v)) {
+                    continue;
+                }
+                SweepEdge* e = &sweep->edges[sv->edges[j]];
+                if(cts_rb_tree_remove(sweep->status, e) == NULL) {
+                    return false;
+                }
+            }
+        }
+
+        // the status now only holds edges crossing the ray away from any vertex
+        for(size_t k = group_begin; k < group_end; k++) {
+            size_t w = sweep->events[k].vertex;
+            if((polygon != NULL) && (sweep->vertices[w].polygon == polygon)) {
+                continue;
+            }
+            row[w] = query_vertex(sweep, source, group_begin, group_end, k);
+        }
+
+        // edges that start on this ray enter the status
+        sweep->removing = false;
+        for(size_t k = group_begin; k < group_end; k++) {
+            size_t v = sweep->events[k].vertex;
+            SweepVertex* sv = &sweep->vertices[v];
+            for(size_t j = 0; j < sv->n_edges; j++) {
+                if(sweep->edge_start[sv->edges[j]] != v) {
+                    continue;
+                }
+                SweepEdge* e = &sweep->edges[sv->edges[j]];
+                if(!cts_rb_tree_insert(sweep->status, e, e)) {
+                    return false;
+                }
+            }
+        }
+
+        group_begin = group_end;
+        group++;
+    }
+    return true;
+}
+
+bool visibility_sweep_row(VisibilitySweep* sweep, size_t source, bool* row) {
+    memset(row, 0, sizeof(bool) * sweep->n_vertices);
+    if(!sweep->usable || !source_is_clear(sweep, source)) {
+        return false;
+    }
+    comparing_sweep = sweep;
+    bool r = sweep_row(sweep, source, row);
+    cts_rb_tree_clear(sweep->status);
+    return r;
+}
@@ -0,0 +1,60 @@
+#ifndef VISIBILITY_SWEEP_H
+#define VISIBILITY_SWEEP_H
+
+#include <Cts/cts.h>
+#include "visibility_graph.h"
+
+/*
+ * Lee's rotational plane sweep for building the visibility graph.
+ *
+ * For every source vertex the other vertices are sorted by angle and a ray is swept around the source.
+ * Obstacle edges that cross the ray are kept in a CtsRbTree ordered by their distance along the ray,
+ * so deciding whether a vertex is visible only needs the nearest edge instead of every polygon edge.
+ * This makes the whole build O(n^2 log n) instead of O(n^3).
+ *
+ * The sweep relies on obstacle edges never touching or crossing each other. When they do (overlapping
+ * obstacles, polygons with fewer than 3 points, ...) visibility_sweep_is_usable() returns false and the
+ * caller should use the brute force build instead. visibility_sweep_row() returns false if it can't
+ * decide a row, which the caller handles the same way for that single row.
+ *
+ * Per row the sweep sorts the vertices on a cheap pseudo angle and puts them in exact order with an
+ * insertion pass. Edges are classified once per row, and their distance along the current ray is cached
+ * for the status comparisons. Blocked vertices are decided from the nearest distance, only near ties go
+ * to the exact predicates.
+ *
+ * A sweep keeps per-row scratch, so one sweep can only run one row at a time. Worker threads each
+ * create their own with visibility_sweep_new_worker(), which shares the vertex and edge tables of
+ * the parent sweep and only allocates the scratch from the worker's allocator.
+ */
+
+CTS_BEGIN_DECLARE_TYPE(CtsBase, VisibilitySweep, visibility_sweep)
+Graph* graph;
+struct VisibilitySweep* parent; // owns vertices and edges for worker sweeps
+struct SweepVertex* vertices;
+struct SweepEdge* edges;
+struct SweepEvent* events;
+size_t* group_of;
+size_t* edge_start; // per row, the end of each edge the sweep reaches first
+double* edge_t; // distance of each edge along the ray edge_ray says it was computed for
+size_t* edge_ray;
+size_t n_vertices;
+size_t n_edges;
+CtsRbTree* status;
+double px, py; // current source
+double rx, ry; // current ray direction
+size_t ray; // counts the rays swept, for edge_ray
+size_t current_group;
+bool removing;
+bool usable;
+CTS_END_DECLARE_TYPE(VisibilitySweep, visibility_sweep)
+
+VisibilitySweep* visibility_sweep_new_from_graph(CtsAllocator* alloc, Graph* graph);
+VisibilitySweep* visibility_sweep_new_worker(CtsAllocator* alloc, VisibilitySweep* parent);
+bool visibility_sweep_is_usable(VisibilitySweep* sweep);
+bool visibility_sweep_row(VisibilitySweep* sweep, size_t source, bool* row);
+
+// visibility row of adjacency node i, using the sweep where it can decide the row and testing every
+// pair otherwise. sweep may be NULL
+void graph_visibility_row(Graph* graph, VisibilitySweep* sweep, size_t i, bool* row);
+
+#endif